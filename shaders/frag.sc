@@ -1,31 +1,39 @@
 $input v_color0 v_lightMapCoord v_lightNormal v_position
 
 #include <bgfx_shader.sh>
-#include "rand.sh"
 
-uniform sampler2D u_shadowMap;
+SAMPLER2DSHADOW(u_shadowMap, 0);
+SAMPLER2D(u_shadowTint, 2);
+SAMPLER2D(u_blueNoise, 3);
 uniform vec4 u_frame;
 
+// how much of this spot is lit. The comparison sampler filters it 2x2 on its own
+float shadowTap(vec2 coord, inout vec3 tint) {
+    tint += texture2D(u_shadowTint, coord).rgb * 0.25;
+    return shadow2D(u_shadowMap, vec3(coord, v_lightMapCoord.z - 0.0025)) * 0.25;
+}
+
 void main() {
-    vec3 shadowSampleCoord = vec3(v_lightMapCoord.xy, 0.0) + vec3(
-        rand2(vec2(rand(gl_FragCoord.x * 0.3 ), gl_FragCoord.y * 0.5)) - 0.5,
-        rand2(vec2(rand(gl_FragCoord.y * 0.4 ), gl_FragCoord.x * 0.1)) - 0.5,
-        rand2(vec2(rand(gl_FragCoord.x * 0.44), gl_FragCoord.y * 0.2)) - 0.5
-    ) * 0.0014;
+    // cos and sin of how much to turn the kernel at this pixel
+    vec2 rotation = texture2D(u_blueNoise, gl_FragCoord.xy / 32.0).rg * 2.0 - 1.0;
+    vec2 right = vec2(rotation.x, rotation.y) * 0.0009;
+    vec2 up = vec2(-rotation.y, rotation.x) * 0.0009;
 
-    vec4 shadowInfo = texture2D(u_shadowMap, shadowSampleCoord.xy);
+    // 4 taps on a rotated grid, so no two of them line up on either axis
+    vec3 tint = vec3(0.0, 0.0, 0.0);
+    float lit = shadowTap(v_lightMapCoord.xy - right * 0.5 - up * 1.5, tint)
+              + shadowTap(v_lightMapCoord.xy + right * 1.5 - up * 0.5, tint)
+              + shadowTap(v_lightMapCoord.xy + right * 0.5 + up * 1.5, tint)
+              + shadowTap(v_lightMapCoord.xy - right * 1.5 + up * 0.5, tint);
 
-    float brightness = 0.9;
-    if(shadowInfo.w < v_lightMapCoord.z + shadowSampleCoord.z - 0.005) {
-        brightness = 0.6;
-    }
+    float brightness = mix(0.6, 0.9, lit);
 
     brightness += dot(v_lightNormal, vec3(0.0, 1.0, 0.0)) * 0.05 + 0.05;
 
     gl_FragData[0] = vec4(
-        v_color0.r * shadowInfo.r * brightness, 
-        v_color0.g * shadowInfo.g * brightness, 
-        v_color0.b * shadowInfo.b * brightness, 
+        v_color0.r * tint.r * brightness, 
+        v_color0.g * tint.g * brightness, 
+        v_color0.b * tint.b * brightness, 
         1.0
     );
 
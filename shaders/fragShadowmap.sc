@@ -1,5 +1,8 @@
 $input v_position
 
+#include <bgfx_shader.sh>
+
 void main() {
-    gl_FragColor = vec4(1.0, 1.0, 1.0, v_position.z);
+    // the depth is all that's needed, this is only written with tinted shadows on
+    gl_FragColor = vec4(1.0, 1.0, 1.0, 1.0);
 }
@@ -0,0 +1,32 @@
+$input v_texCoord v_color0
+
+#include <bgfx_shader.sh>
+
+SAMPLER2D(u_texture, 0);
+// [0]: xy how much of the texture the scene was drawn over, zw where that starts
+// [1]: xy the size of a texel, z how much to sharpen
+uniform vec4 u_upscale[2];
+
+// anything outside of where the scene was drawn is left over from an older frame
+vec4 sampleScene(vec2 uv) {
+    vec2 texel = u_upscale[1].xy;
+    vec2 low = u_upscale[0].zw + texel * 0.5;
+    vec2 high = u_upscale[0].zw + u_upscale[0].xy - texel * 0.5;
+    return texture2D(u_texture, clamp(uv, low, high));
+}
+
+void main() {
+    vec2 uv = v_texCoord * u_upscale[0].xy + u_upscale[0].zw;
+    vec2 texel = u_upscale[1].xy;
+    float sharpness = u_upscale[1].z;
+
+    // bilinear from the sampler, then sharpened to make up for some of the blur
+    vec4 center = sampleScene(uv);
+    vec4 around = sampleScene(uv + vec2(texel.x, 0.0))
+                + sampleScene(uv - vec2(texel.x, 0.0))
+                + sampleScene(uv + vec2(0.0, texel.y))
+                + sampleScene(uv - vec2(0.0, texel.y));
+
+    gl_FragColor = clamp(center * (1.0 + 4.0 * sharpness) - around * sharpness, 0.0, 1.0);
+    gl_FragColor *= v_color0;
+}
@@ -2,6 +2,10 @@ vec3 a_position: POSITION;
 vec3 a_normal: NORMAL;
 vec2 a_texcoord0: TEXCOORD0;
 vec4 a_color0: COLOR0 = vec4(1.0, 1.0, 1.0, 1.0);
+vec4 i_data0: TEXCOORD7;
+vec4 i_data1: TEXCOORD6;
+vec4 i_data2: TEXCOORD5;
+vec4 i_data3: TEXCOORD4;
 
 vec4 v_position: POSITION;
 vec3 v_lightNormal: NORMAL;
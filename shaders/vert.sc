@@ -13,6 +13,7 @@ void main() {
     v_lightMapCoord = mul(u_lightMapMtx, mul(u_modelMtx, vec4(a_position, 1.0))).xyz;
     v_lightMapCoord.x = v_lightMapCoord.x * 0.5 + 0.5;
     v_lightMapCoord.y = v_lightMapCoord.y * 0.5 + 0.5;
+    v_lightMapCoord.z = v_lightMapCoord.z * 0.5 + 0.5;
 
     v_lightNormal = mul(u_lightDirMtx, mul(u_modelMtx, vec4(a_normal, 0.0))).xyz;
     v_color0 = a_color0;
@@ -0,0 +1,23 @@
+$input a_position, a_normal, a_color0, i_data0, i_data1, i_data2, i_data3
+$output v_color0 v_lightMapCoord v_lightNormal v_position
+
+#include <bgfx_shader.sh>
+
+uniform mat4 u_lightMapMtx;
+uniform mat4 u_lightDirMtx;
+
+void main() {
+    // each instance's model matrix, instead of u_modelMtx/u_model
+    mat4 model = mtxFromCols(i_data0, i_data1, i_data2, i_data3);
+    vec4 worldPosition = mul(model, vec4(a_position, 1.0));
+
+    gl_Position = mul(u_viewProj, worldPosition);
+    v_position = gl_Position;
+    v_lightMapCoord = mul(u_lightMapMtx, worldPosition).xyz;
+    v_lightMapCoord.x = v_lightMapCoord.x * 0.5 + 0.5;
+    v_lightMapCoord.y = v_lightMapCoord.y * 0.5 + 0.5;
+    v_lightMapCoord.z = v_lightMapCoord.z * 0.5 + 0.5;
+
+    v_lightNormal = mul(u_lightDirMtx, mul(model, vec4(a_normal, 0.0))).xyz;
+    v_color0 = a_color0;
+}
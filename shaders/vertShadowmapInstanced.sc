@@ -0,0 +1,12 @@
+$input a_position, i_data0, i_data1, i_data2, i_data3
+$output v_position
+
+#include <bgfx_shader.sh>
+
+void main() {
+    mat4 model = mtxFromCols(i_data0, i_data1, i_data2, i_data3);
+    vec4 worldPosition = mul(model, vec4(a_position, 1.0));
+
+    gl_Position = mul(u_viewProj, worldPosition);
+    v_position  = mul(u_viewProj, worldPosition);
+}
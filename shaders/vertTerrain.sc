@@ -0,0 +1,40 @@
+$input a_position
+$output v_color0 v_lightMapCoord v_lightNormal v_position
+
+#include <bgfx_shader.sh>
+
+uniform mat4 u_lightMapMtx;
+uniform mat4 u_lightDirMtx;
+uniform mat4 u_modelMtx;
+// for each tile type, the color then how much the height adds to it
+uniform vec4 u_palette[6];
+
+SAMPLER2D(u_heightmap, 1);
+
+// height and tile type. The heightmap has a tile of padding on the top/left and two on the bottom/right
+vec2 heightmapTile(vec2 tile) {
+    return texture2DLod(u_heightmap, (tile + vec2(1.5, 1.5)) / 19.0, 0.0).xy;
+}
+
+void main() {
+    vec2 tile = a_position.xz;
+    vec2 heightAndType = heightmapTile(tile);
+    vec3 position = vec3(tile.x, heightAndType.x, tile.y);
+
+    gl_Position = mul(u_modelViewProj, vec4(position, 1.0));
+    v_position = gl_Position;
+    v_lightMapCoord = mul(u_lightMapMtx, mul(u_modelMtx, vec4(position, 1.0))).xyz;
+    v_lightMapCoord.x = v_lightMapCoord.x * 0.5 + 0.5;
+    v_lightMapCoord.y = v_lightMapCoord.y * 0.5 + 0.5;
+    v_lightMapCoord.z = v_lightMapCoord.z * 0.5 + 0.5;
+
+    float left  = heightmapTile(tile + vec2(-1.0,  0.0)).x;
+    float right = heightmapTile(tile + vec2( 1.0,  0.0)).x;
+    float up    = heightmapTile(tile + vec2( 0.0, -1.0)).x;
+    float down  = heightmapTile(tile + vec2( 0.0,  1.0)).x;
+    vec3 normal = normalize(vec3(left - right, 2.0, up - down));
+    v_lightNormal = mul(u_lightDirMtx, mul(u_modelMtx, vec4(normal, 0.0))).xyz;
+
+    int type = int(heightAndType.y + 0.5);
+    v_color0 = vec4(clamp(u_palette[type * 2].rgb + u_palette[type * 2 + 1].rgb * heightAndType.x, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,15 @@
+$input a_position
+$output v_position
+
+#include <bgfx_shader.sh>
+
+SAMPLER2D(u_heightmap, 1);
+
+void main() {
+    vec2 tile = a_position.xz;
+    float height = texture2DLod(u_heightmap, (tile + vec2(1.5, 1.5)) / 19.0, 0.0).x;
+    vec3 position = vec3(tile.x, height, tile.y);
+
+    gl_Position = mul(u_modelViewProj, vec4(position, 1.0));
+    v_position  = mul(u_modelViewProj, vec4(position, 1.0));
+}
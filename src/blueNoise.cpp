@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "blueNoise.h"
+#include "mathUtils.h"
+
+static int const PIXELS = BLUE_NOISE_SIZE * BLUE_NOISE_SIZE;
+
+namespace {
+    /**
+     * @brief Which pixels are set, and how crowded every pixel is by the set ones around it
+     * The energy is a gaussian of the distance to every set pixel, wrapping around the edges
+     */
+    struct Pattern {
+        std::array<bool, PIXELS> set{};
+        std::array<float, PIXELS> energy{};
+
+        void toggle(int const pixel) {
+            static auto const kernel = [](){
+                // sigma of 1.5, as suggested by the original paper
+                std::array<float, PIXELS> ret;
+                for(int y = 0; y < BLUE_NOISE_SIZE; y++) for(int x = 0; x < BLUE_NOISE_SIZE; x++) {
+                    int const dx = std::min(x, BLUE_NOISE_SIZE - x);
+                    int const dy = std::min(y, BLUE_NOISE_SIZE - y);
+                    ret[y * BLUE_NOISE_SIZE + x] = std::exp(-(dx * dx + dy * dy) / (2.f * 1.5f * 1.5f));
+                }
+                return ret;
+            }();
+
+            this->set[pixel] = !this->set[pixel];
+            float const sign = this->set[pixel]? 1.f : -1.f;
+
+            int const px = pixel % BLUE_NOISE_SIZE;
+            int const py = pixel / BLUE_NOISE_SIZE;
+            for(int y = 0; y < BLUE_NOISE_SIZE; y++) for(int x = 0; x < BLUE_NOISE_SIZE; x++) {
+                int const kx = (x - px + BLUE_NOISE_SIZE) % BLUE_NOISE_SIZE;
+                int const ky = (y - py + BLUE_NOISE_SIZE) % BLUE_NOISE_SIZE;
+                this->energy[y * BLUE_NOISE_SIZE + x] += sign * kernel[ky * BLUE_NOISE_SIZE + kx];
+            }
+        }
+
+        // the set pixel with the most set pixels around it
+        int tightestCluster() const {
+            int ret = -1;
+            for(int i = 0; i < PIXELS; i++) {
+                if(this->set[i] && (ret < 0 || this->energy[i] > this->energy[ret])) ret = i;
+            }
+            return ret;
+        }
+
+        // the unset pixel with the fewest set pixels around it
+        int largestVoid() const {
+            int ret = -1;
+            for(int i = 0; i < PIXELS; i++) {
+                if(!this->set[i] && (ret < 0 || this->energy[i] < this->energy[ret])) ret = i;
+            }
+            return ret;
+        }
+    };
+}
+
+std::array<uint16_t, BLUE_NOISE_SIZE * BLUE_NOISE_SIZE> generateBlueNoise(uint32_t const seed) {
+    // a tenth of the pixels to start with, at random
+    Pattern initial;
+    int const initialCount = PIXELS / 10;
+    for(int placed = 0, i = 0; placed < initialCount; i++) {
+        int const pixel = hashCoord(i, 0, seed) % PIXELS;
+        if(initial.set[pixel]) continue;
+        initial.toggle(pixel);
+        placed++;
+    }
+
+    // spread them out evenly, by moving the most crowded one to the emptiest spot until
+    // that'd just put it back where it was
+    while(true) {
+        int const cluster = initial.tightestCluster();
+        initial.toggle(cluster);
+        int const gap = initial.largestVoid();
+        initial.toggle(gap);
+        if(gap == cluster) break;
+    }
+
+    std::array<uint16_t, PIXELS> ret;
+
+    // the starting pixels get the lowest ranks, most crowded first to go
+    Pattern pattern = initial;
+    for(int rank = initialCount - 1; rank >= 0; rank--) {
+        int const cluster = pattern.tightestCluster();
+        pattern.toggle(cluster);
+        ret[cluster] = rank;
+    }
+
+    // then everything else, each going in the emptiest spot left
+    pattern = initial;
+    for(int rank = initialCount; rank < PIXELS; rank++) {
+        int const gap = pattern.largestVoid();
+        pattern.toggle(gap);
+        ret[gap] = rank;
+    }
+
+    return ret;
+}
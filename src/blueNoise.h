@@ -0,0 +1,16 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+int const BLUE_NOISE_SIZE = 32;
+
+/**
+ * @brief Generates a tileable square of blue noise with the void and cluster method
+ * Every value from 0 to BLUE_NOISE_SIZE^2 - 1 shows up exactly once, and values close
+ * to each other are spread out as far as they can be
+ * 
+ * @param seed only changes the starting pattern
+ * @return std::array<uint16_t, BLUE_NOISE_SIZE * BLUE_NOISE_SIZE> 
+ */
+std::array<uint16_t, BLUE_NOISE_SIZE * BLUE_NOISE_SIZE> generateBlueNoise(uint32_t const seed);
@@ -7,58 +7,195 @@
 #include "chunk.h"
 #include "mathUtils.h"
 #include "modelInstance.h"
+#include "config.h"
+#include "rendererState.h"
 
 #ifdef __INTELLISENSE__
 #pragma diag_suppress 29
 #endif
-static auto const chunkIndices = std::vector<std::vector<uint32_t>>{
-    #include "./chunkIndices/ind000"
-    ,
-    #include "./chunkIndices/ind001"
-    ,
-    #include "./chunkIndices/ind010"
-    ,
-    #include "./chunkIndices/ind011"
-    ,
-    #include "./chunkIndices/ind100"
-    ,
-    #include "./chunkIndices/ind101"
-    ,
-    #include "./chunkIndices/ind110"
-    ,
+static auto const chunkIndices = std::vector<uint32_t>
     #include "./chunkIndices/ind111"
-    ,
+;
+
+/**
+ * @brief Gets the index buffer for a chunk mesh
+ * Every chunk is meshed with its seams, so they all have the same topology and
+ * the index buffer is only uploaded once
+ * 
+ * @return bgfx::IndexBufferHandle 
+ */
+static bgfx::IndexBufferHandle sharedChunkIndexBuffer() {
+    static auto const buffer = [](){
+        // a chunk has 16 * 16 + 33 vertices, so 16 bit indices are plenty
+        auto const mem = bgfx::alloc(chunkIndices.size() * sizeof(uint16_t));
+        std::copy(chunkIndices.begin(), chunkIndices.end(), (uint16_t*)mem->data);
+        return bgfx::createIndexBuffer(mem);
+    }();
+
+    return buffer;
+}
+
+/**
+ * @brief Whether chunks are drawn as a shared grid displaced by their heightmaps
+ * Needs vertex shaders to be able to sample the heightmap's format, which not every GPU can
+ */
+static bool useHeightmapTerrain() {
+    static bool const use = [](){
+        if(!config.graphics.heightmapTerrain) return false;
+
+        bool const supported = bgfx::getCaps()->formats[bgfx::TextureFormat::RG16F] & BGFX_CAPS_FORMAT_TEXTURE_VERTEX;
+        if(!supported) fprintf(stderr, "Heightmaps can't be sampled in vertex shaders, using meshes for terrain instead\n");
+        return supported;
+    }();
+
+    return use;
+}
+
+static bgfx::VertexLayout const & chunkGridLayout() {
+    static auto const layout = [](){
+        bgfx::VertexLayout ret;
+        ret
+            .begin()
+            .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+            .end();
+        return ret;
+    }();
+
+    return layout;
+}
+
+/**
+ * @brief Gets the grid every chunk is drawn with when using heightmaps
+ * The heights are all 0, the terrain shaders move them up to the heightmap. In the same
+ * order as asPrimitive's vertices, so it goes with the same index buffer
+ * 
+ * @return bgfx::VertexBufferHandle 
+ */
+static bgfx::VertexBufferHandle sharedChunkGridBuffer() {
+    static auto const buffer = [](){
+        std::vector<std::array<float, 3>> vertices;
+        vertices.reserve(17 * 17);
+        for(int z = 0; z < 16; z++) for(int x = 0; x < 16; x++) vertices.push_back({(float)x, 0.f, (float)z});
+        for(int z = 0; z < 16; z++) vertices.push_back({16.f, 0.f, (float)z});
+        for(int x = 0; x < 16; x++) vertices.push_back({(float)x, 0.f, 16.f});
+        vertices.push_back({16.f, 0.f, 16.f});
+
+        auto const mem = bgfx::copy(vertices.data(), vertices.size() * sizeof(vertices[0]));
+        return bgfx::createVertexBuffer(mem, chunkGridLayout());
+    }();
+
+    return buffer;
+}
+
+struct DecimatedMesh {
+    // chunk local tile coordinates, 16 being the seams with the right/bottom chunks
+    std::vector<std::pair<uint8_t, uint8_t>> vertices;
+    std::vector<uint16_t> indices;
+    bgfx::IndexBufferHandle indexBuffer;
 };
 
+/**
+ * @brief Gets the layout of a lower detail chunk mesh
+ * The inside is a grid with a tile every 2^lod tiles, but the edges keep every tile so
+ * it lines up with whatever detail its neighbors are at. Cells on the edge are fanned
+ * out from their center to connect the two. Like the full detail meshes, the index buffer
+ * is shared between every chunk
+ * 
+ * @param lod 1 to Chunk::MAX_LOD
+ * @return DecimatedMesh const& 
+ */
+static DecimatedMesh const & decimatedMesh(int const lod) {
+    static auto const meshes = [](){
+        std::array<DecimatedMesh, Chunk::MAX_LOD> ret;
+
+        for(int level = 1; level <= Chunk::MAX_LOD; level++) {
+            auto& mesh = ret[level - 1];
+            int const stride = 1 << level;
+            int const gridSize = 16 / stride + 1;
+
+            for(int z = 0; z <= 16; z += stride) for(int x = 0; x <= 16; x += stride) {
+                mesh.vertices.push_back({x, z});
+            }
+
+            std::map<std::pair<int, int>, uint16_t> extraVertices;
+            auto const vertex = [&](int const x, int const z) -> uint16_t {
+                if(x % stride == 0 && z % stride == 0) return (z / stride) * gridSize + x / stride;
+
+                auto [found, inserted] = extraVertices.insert({{x, z}, (uint16_t)mesh.vertices.size()});
+                if(inserted) mesh.vertices.push_back({x, z});
+                return found->second;
+            };
+
+            for(int z0 = 0; z0 < 16; z0 += stride) for(int x0 = 0; x0 < 16; x0 += stride) {
+                int const x1 = x0 + stride;
+                int const z1 = z0 + stride;
+
+                if(x0 != 0 && z0 != 0 && x1 != 16 && z1 != 16) {
+                    mesh.indices.insert(mesh.indices.end(), {
+                        vertex(x0, z0), vertex(x0, z1), vertex(x1, z1),
+                        vertex(x0, z0), vertex(x1, z1), vertex(x1, z0),
+                    });
+                    continue;
+                }
+
+                // going around the cell the same way the triangles above wind
+                std::vector<uint16_t> perimeter;
+                for(int z = z0; z < z1; z += (x0 == 0 ? 1 : stride)) perimeter.push_back(vertex(x0, z));
+                for(int x = x0; x < x1; x += (z1 == 16? 1 : stride)) perimeter.push_back(vertex(x, z1));
+                for(int z = z1; z > z0; z -= (x1 == 16? 1 : stride)) perimeter.push_back(vertex(x1, z));
+                for(int x = x1; x > x0; x -= (z0 == 0 ? 1 : stride)) perimeter.push_back(vertex(x, z0));
+
+                auto const center = vertex(x0 + stride / 2, z0 + stride / 2);
+                for(std::size_t i = 0; i < perimeter.size(); i++) {
+                    mesh.indices.insert(mesh.indices.end(), {
+                        center, perimeter[i], perimeter[(i + 1) % perimeter.size()]
+                    });
+                }
+            }
+
+            auto const mem = bgfx::copy(mesh.indices.data(), mesh.indices.size() * sizeof(uint16_t));
+            mesh.indexBuffer = bgfx::createIndexBuffer(mem);
+        }
+
+        return ret;
+    }();
+
+    return meshes[lod - 1];
+}
+
 constexpr RGB<float> Tile::color() const {
-    float const rGrassColorScale = 0.01f;
-    float const gGrassColorScale = 0.02f;
-    float const bGrassColorScale = 0.01f;
-    float const rGrassColorOffset = 0.05f;
-    float const gGrassColorOffset = 0.7f;
-    float const bGrassColorOffset = 0.02;
-    switch(this->type) {
-    case Tile::Type::Grass:
-        return {
-            .r = this->height * rGrassColorScale + rGrassColorOffset,
-            .g = this->height * gGrassColorScale + gGrassColorOffset,
-            .b = this->height * bGrassColorScale + bGrassColorOffset,
-        };
+    auto const & entry = Tile::palette[this->type];
+    return {
+        .r = this->height * entry.heightScale.r + entry.offset.r,
+        .g = this->height * entry.heightScale.g + entry.offset.g,
+        .b = this->height * entry.heightScale.b + entry.offset.b,
+    };
+}
 
-    case Tile::Type::Blasted:
-        return {
-            .r = 0.23f,
-            .g = 0.23f,
-            .b = 0.23f,
-        };
+TerrainVertex TerrainVertex::fromTile(int const x, int const z, Tile const & tile, PackedNormal const & normal) {
+    return TerrainVertex{
+        .x = bx::halfFromFloat((float)x),
+        .height = bx::halfFromFloat(tile.height),
+        .z = bx::halfFromFloat((float)z),
+        .padding = 0,
+        .normal = normal,
+        .color = tile.color().asABGR8(),
+    };
+}
 
-    case Tile::Type::Dirt:
-        return {
-            .r = 0.5f,
-            .g = 0.4f,
-            .b = 0.2f,
-        };
-    }
+bgfx::VertexLayout const & TerrainVertex::layout() {
+    static auto const layout = [](){
+        bgfx::VertexLayout ret;
+        ret
+            .begin()
+            .add(bgfx::Attrib::Position, 4, bgfx::AttribType::Half)
+            .add(bgfx::Attrib::Normal, 4, bgfx::AttribType::Int16, true)
+            .add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true)
+            .end();
+        return ret;
+    }();
+
+    return layout;
 }
 
 EntityId createWorldEntity() { 
@@ -69,15 +206,15 @@ EntityId createWorldEntity() {
             .chance = 0.0001f,
             .seedOffset = 0x7f7e,
             .decorate = [](int x, int z){
-                for(int i = -13; i <= 13; ++i) {
-                    for(int j = -13; j <= 13; ++j) {
-                        if(i*i + j*j < 160) {
-                            world.getTileMut(x + i, z + j)->type = Tile::Type::Blasted;
-                            world.getTileMut(x + i, z + j)->height -= 
-                                10 * std::cos(std::numbers::pi * std::sqrt(i*i + j*j) / 13 / 2);
-                        }
+                world.editTiles(x - 13, z - 13, x + 13, z + 13, [=](int const tx, int const tz, Tile& tile) {
+                    auto const i = tx - x;
+                    auto const j = tz - z;
+                    if(i*i + j*j < 160) {
+                        tile.type = Tile::Type::Blasted;
+                        tile.height -= 
+                            10 * std::cos(std::numbers::pi * std::sqrt(i*i + j*j) / 13 / 2);
                     }
-                }
+                });
             }
         },
         DecoratorPattern{ // Tree
@@ -85,50 +222,44 @@ EntityId createWorldEntity() {
             .chance = 0.001f,
             .seedOffset = 0xfee3,
             .decorate = [](int x, int z){
-                auto tree = entitySystem.newEntity();
-                entitySystem.addComponent(tree, "Tree");
-                entitySystem.addComponent(tree, ModelInstance::fromModelPtr(LOAD_MODEL("tree.glb")));
-                auto& o = entitySystem.getComponentData<ModelInstance>(tree).orientation;
-                o[12] = x;
-                o[13] = world.getTile(x, z)->height;
-                o[14] = z;
-
                 // GDDDG
                 // DDDDD
                 // DDTDD
                 // DDDDD
                 // GDDDG
-                world.getTileMut(x - 1, z - 2)->type = Tile::Type::Dirt;
-                world.getTileMut(x    , z - 2)->type = Tile::Type::Dirt;
-                world.getTileMut(x + 1, z - 2)->type = Tile::Type::Dirt;
-                world.getTileMut(x - 2, z - 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x - 1, z - 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x    , z - 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x + 1, z - 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x + 2, z - 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x - 2, z    )->type = Tile::Type::Dirt;
-                world.getTileMut(x - 1, z    )->type = Tile::Type::Dirt;
-                world.getTileMut(x    , z    )->type = Tile::Type::Dirt;
-                world.getTileMut(x + 1, z    )->type = Tile::Type::Dirt;
-                world.getTileMut(x + 2, z    )->type = Tile::Type::Dirt;
-                world.getTileMut(x - 2, z + 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x - 1, z + 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x    , z + 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x + 1, z + 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x + 2, z + 1)->type = Tile::Type::Dirt;
-                world.getTileMut(x - 1, z + 2)->type = Tile::Type::Dirt;
-                world.getTileMut(x    , z + 2)->type = Tile::Type::Dirt;
-                world.getTileMut(x + 1, z + 2)->type = Tile::Type::Dirt;
-            }
+                world.editTiles(x - 2, z - 2, x + 2, z + 2, [=](int const tx, int const tz, Tile& tile) {
+                    if(std::abs(tx - x) == 2 && std::abs(tz - z) == 2) return;
+                    tile.type = Tile::Type::Dirt;
+                });
+            },
+            .populate = [](int x, int z, std::vector<Decoration>& out){
+                static auto const treeModel = world.decorationModelId(LOAD_MODEL("tree.glb"));
+                out.push_back({
+                    .position = {(float)x, world.getTile(x, z)->height, (float)z},
+                    .yaw = hashCoord(x, z, 0xfee3) / 4294967296.f * 2.f * std::numbers::pi_v<float>,
+                    .model = treeModel,
+                });
+            },
         },
 
     };
 
+    for(std::size_t i = 0; i < Tile::palette.size(); i++) {
+        auto const & [offset, heightScale] = Tile::palette[i];
+        rendererState.terrainPalette[i * 2]     = {offset.r, offset.g, offset.b, 0.f};
+        rendererState.terrainPalette[i * 2 + 1] = {heightScale.r, heightScale.g, heightScale.b, 0.f};
+    }
+
+    if(config.world.saveChunks) {
+        world.regionStore = std::make_unique<RegionStore>("world", world.worldSeed);
+    }
+
     auto terrain = entitySystem.newEntity();
     entitySystem.addComponent(terrain, "World");
     entitySystem.addComponent(terrain, ModelInstance::fromModelPtr(world.updateModel(0, 0, 1)));
     auto& mi = entitySystem.getComponentData<ModelInstance>(terrain);
     mi.mustRender = true;
+    mi.staticShadow = true;
     auto& terrainOrientation = mi.orientation;
     terrainOrientation[12] = 0.f;
     terrainOrientation[13] = 0.f;
@@ -140,23 +271,137 @@ EntityId createWorldEntity() {
 Chunk Chunk::generateSkeleton(int chunkX, int chunkZ, int seed) {
     Chunk ret;
 
-    auto preConvHeightMap = generateNoise<18>(
+    // bigger than the chunk, the noise only depends on the world coordinate so the
+    // ring around it is exactly what the neighbors' skeletons start with
+    auto preConvHeightMap = generateNoise<21>(
         seed,
-        chunkX * 16 - 1,
-        chunkZ * 16 - 1,
+        chunkX * 16 - 2,
+        chunkZ * 16 - 2,
         {{0.3f, 0.6f, 4}, {0.04f, 6.f, 7}, {0.6f, 0.2f, 333}}
     );
-    auto postConvHeightMap = convolute<18, 3>(preConvHeightMap, {
+    auto postConvHeightMap = convolute<21, 3>(preConvHeightMap, {
         1.f, 1.f, 1.f,
         1.f, 4.f, 1.f,
         1.f, 1.f, 1.f
     }, 1.f/12);
+    auto const height = [&](int const x, int const z) {
+        return postConvHeightMap[(z + 1) * 19 + x + 1] * 5 - 20;
+    };
 
-    for(std::size_t i = 0; i < ret.tiles.size(); i++) {
-        ret.tiles[i] = {
-            .height = postConvHeightMap[i] * 5 - 20,
+    for(int z = 0; z < 16; z++) for(int x = 0; x < 16; x++) {
+        ret.setTile(z * 16 + x, {
+            .height = height(x, z),
             .type = Tile::Type::Grass,
+        });
+    }
+    for(int z = -1; z <= 17; z++) for(int x = -1; x <= 17; x++) {
+        if(x < 0 || x >= 16 || z < 0 || z >= 16) ret.borderHeights[Chunk::borderIndex(x, z)] = height(x, z);
+    }
+
+    return ret;
+}
+
+std::size_t ChunkDelta::memoryUsage() const {
+    return sizeof(ChunkDelta)
+         + this->tiles.capacity() * sizeof(TileDelta)
+         + this->heights.capacity() * sizeof(Chunk::StoredHeight)
+         + this->types.capacity() * sizeof(Tile::Type);
+}
+
+ChunkDelta Chunk::asDelta(int chunkX, int chunkZ, int seed) const {
+    auto const baseline = Chunk::generateSkeleton(chunkX, chunkZ, seed);
+
+    ChunkDelta ret{
+        .isSkeleton = this->isSkeleton,
+    };
+
+    // stored as is rather than through height(), so nothing is lost going back and forth
+    for(std::size_t i = 0; i < this->heights.size(); i++) {
+        if(this->heights[i] != baseline.heights[i]
+        || this->types[i]   != baseline.types[i]
+        ) {
+            ret.tiles.push_back({
+                .height = this->heights[i],
+                .index = (uint8_t)i,
+                .type = this->types[i],
+            });
+        }
+    }
+
+    // edited all over, so the whole chunk is smaller than the list of changes
+    std::size_t const fullSize = sizeof(this->heights) + sizeof(this->types);
+    if(ret.tiles.size() * sizeof(ChunkDelta::TileDelta) > fullSize) {
+        ret.tiles.clear();
+        ret.heights.assign(this->heights.begin(), this->heights.end());
+        ret.types.assign(this->types.begin(), this->types.end());
+    }
+    ret.tiles.shrink_to_fit();
+
+    return ret;
+}
+
+Chunk Chunk::fromDelta(int chunkX, int chunkZ, int seed, ChunkDelta const & delta) {
+    auto ret = Chunk::generateSkeleton(chunkX, chunkZ, seed);
+
+    if(!delta.heights.empty()) {
+        std::copy(delta.heights.begin(), delta.heights.end(), ret.heights.begin());
+        std::copy(delta.types.begin(), delta.types.end(), ret.types.begin());
+    }
+    for(auto const & tile: delta.tiles) {
+        ret.heights[tile.index] = tile.height;
+        ret.types[tile.index] = tile.type;
+    }
+    ret.isSkeleton = delta.isSkeleton;
+    ret.edited = true;
+
+    return ret;
+}
+
+std::vector<DecorationJob> Chunk::decorationSites(
+    int chunkX,
+    int chunkZ,
+    int seed,
+    std::vector<DecoratorPattern> const & patterns
+) {
+    std::vector<DecorationJob> ret;
+    std::vector<uint32_t> candidates;
+
+    for(auto const & pattern: patterns) {
+        // a candidate is thrown out if there's another one in the radius x radius square
+        // starting at it, so the candidates are needed that far past the chunk too
+        int const radius = std::max(pattern.radius, 1);
+        int const size = 16 + radius - 1;
+        uint32_t const threshold = (uint32_t)std::min(pattern.chance * 4294967296.0, 4294967295.0);
+        uint32_t const patternSeed = (uint32_t)(seed ^ pattern.seedOffset);
+
+        // summed area table of where the candidates are, with a row and column of 0s in front
+        // so any square of it can be counted with 4 lookups
+        int const stride = size + 1;
+        candidates.assign(stride * stride, 0);
+        for(int z = 0; z < size; z++) {
+            uint32_t rowCount = 0;
+            for(int x = 0; x < size; x++) {
+                rowCount += hashCoord(chunkX * 16 + x, chunkZ * 16 + z, patternSeed) < threshold;
+                candidates[(z + 1) * stride + x + 1] = candidates[z * stride + x + 1] + rowCount;
+            }
+        }
+        // nothing here, which is most of the time
+        if(candidates.back() == 0) continue;
+
+        auto const count = [&](int const x0, int const z0, int const x1, int const z1) {
+            return candidates[z1 * stride + x1] 
+                 - candidates[z0 * stride + x1] 
+                 - candidates[z1 * stride + x0] 
+                 + candidates[z0 * stride + x0];
         };
+
+        for(int z = 0; z < 16; z++) for(int x = 0; x < 16; x++) {
+            if(count(x, z, x + 1, z + 1) == 0) continue;
+            // only itself
+            if(count(x, z, x + radius, z + radius) == 1) {
+                ret.push_back({&pattern, chunkX * 16 + x, chunkZ * 16 + z});
+            }
+        }
     }
 
     return ret;
@@ -166,147 +411,410 @@ void Chunk::finishGeneration(
     int chunkX, 
     int chunkZ, 
     int seed, 
-    std::vector<DecoratorPattern> patterns,
+    std::vector<DecoratorPattern> const & patterns,
     std::set<std::tuple<int, int>>& outSkeletonChunkRequests,
-    std::vector<std::function<void()>>& outDecorators
+    std::vector<DecorationJob>& outDecorations
 ) {
-    for(auto pattern: patterns) {
-        for(int i = 0; i < 256; i++) {
-            auto x = chunkX * 16 + i / 16;
-            auto z = chunkZ * 16 + i % 16;
-
-            if(randFromCoord(x, z, seed ^ pattern.seedOffset) < pattern.chance) {
-                bool invalidated = false;
-                for(int d = 1; d < pattern.radius * pattern.radius; d++) {
-                    auto dx = d / pattern.radius;
-                    auto dz = d % pattern.radius;
-
-                    invalidated = randFromCoord(x + dx, z + dz, seed ^ pattern.seedOffset) < pattern.chance;
-
-                    if(invalidated) break;
-                }
+    auto const sites = Chunk::decorationSites(chunkX, chunkZ, seed, patterns);
 
-                if(!invalidated) {
-                    for(int skelx = (x - pattern.radius - 15) / 16; skelx <= (x + pattern.radius) / 16; skelx++) {
-                        for(int skelz = (z - pattern.radius - 15) / 16; skelz <= (z + pattern.radius) / 16; skelz++) {
-                            if(skelx != 0 || skelz != 0) {
-                                outSkeletonChunkRequests.insert(std::make_tuple(skelx, skelz));
-                            }
-                        }
-                    }
-
-                    outDecorators.emplace_back([=]() {pattern.decorate(x, z);});
-                }
+    for(auto const & [pattern, x, z]: sites) {
+        // every chunk the decoration could reach into needs to be there for it to be edited
+        auto const [minSkelX, _minX] = floorDivMod(x - pattern->radius, 16);
+        auto const [minSkelZ, _minZ] = floorDivMod(z - pattern->radius, 16);
+        auto const [maxSkelX, _maxX] = floorDivMod(x + pattern->radius, 16);
+        auto const [maxSkelZ, _maxZ] = floorDivMod(z + pattern->radius, 16);
+        for(int skelz = minSkelZ; skelz <= maxSkelZ; skelz++) for(int skelx = minSkelX; skelx <= maxSkelX; skelx++) {
+            if(skelx != chunkX || skelz != chunkZ) {
+                outSkeletonChunkRequests.insert(std::make_tuple(skelx, skelz));
             }
         }
     }
 
+    // decorators only ever run once, so this chunk can't just be regenerated anymore
+    if(!sites.empty()) this->edited = true;
+    outDecorations.insert(outDecorations.end(), sites.begin(), sites.end());
+
     this->isSkeleton = false;
 }
 
 Model::Primitive Chunk::asPrimitive(
     int const chunkOffsetX,
     int const chunkOffsetZ,
-    std::optional<Chunk> rightChunk,
-    std::optional<Chunk> bottomChunk,
-    std::optional<Chunk> bottomRightChunk
+    ChunkNeighbors const & neighbors,
+    int const lod
 ) {
-    if(this->primitive.has_value()
-    && (rightChunk.has_value()       <= (this->primitiveGenerationState & GENERATION_STATE_RIGHT_FINISHED))
-    && (bottomChunk.has_value()      <= (this->primitiveGenerationState & GENERATION_STATE_BOTTOM_FINISHED))
-    && (bottomRightChunk.has_value() <= (this->primitiveGenerationState & GENERATION_STATE_BOTTOM_RIGHT_FINISHED))
-    ) {
+    if(useHeightmapTerrain()) {
+        if(!this->primitive.has_value()) {
+            return this->asHeightmapPrimitive(chunkOffsetX, chunkOffsetZ, neighbors);
+        }
+
+        if(this->hasDirtyVertices()) {
+            // tile (x, z) is texel (x + 1, z + 1). The ring around the rectangle goes
+            // too, since it's what the shader works the normals out from
+            this->uploadHeightmap(
+                neighbors,
+                this->dirtyMinX,
+                this->dirtyMinZ,
+                std::min(this->dirtyMaxX + 2, 18),
+                std::min(this->dirtyMaxZ + 2, 18)
+            );
+            this->primitive->bounds = this->meshBounds(neighbors);
+            this->resetDirtyVertices();
+        }
+
         return this->primitive.value();
     }
 
+    int const meshLod = std::clamp(lod, 0, MAX_LOD);
+
+    if(this->primitive.has_value() && this->primitiveLod == meshLod) {
+        if(meshLod == 0) {
+            this->uploadDirtyVertices(neighbors);
+            return this->primitive.value();
+        }
+
+        // the lower detail meshes are small enough to just be rebuilt when they're edited
+        if(!this->hasDirtyVertices()) {
+            return this->primitive.value();
+        }
+    }
+
     this->unloadPrimitive();
 
-    this->primitiveGenerationState = 0
-        | (rightChunk.has_value()? GENERATION_STATE_RIGHT_FINISHED : 0)
-        | (bottomChunk.has_value()? GENERATION_STATE_BOTTOM_FINISHED : 0)
-        | (bottomRightChunk.has_value()? GENERATION_STATE_BOTTOM_RIGHT_FINISHED : 0);
-
-    std::vector<float> vertices;
-    std::vector<uint32_t> const & indices = chunkIndices[this->primitiveGenerationState];
-    auto const vertexSize = 3 + 4;
-    vertices.reserve((this->tiles.size() + 33) * vertexSize);
-
-    for(int64_t i = 0; i < (int64_t)this->tiles.size(); i++) {
-        vertices.push_back((float)(i % 16 + chunkOffsetX * 16));
-        vertices.push_back((float)(this->tiles[i].height));
-        vertices.push_back((float)(i / 16 + chunkOffsetZ * 16)); // NOLINT(bugprone-integer-division)
-        this->tiles[i].color().appendToVector(vertices);
-        vertices.push_back(1.f);
-    }
-    std::size_t const rightChunkOffset = vertices.size() / vertexSize;
-    if(rightChunk.has_value()) for(int i = 0; i < 16; i++) {
-        vertices.push_back((float)(16 + chunkOffsetX * 16));
-        vertices.push_back((float)(rightChunk->tiles[i * 16].height));
-        vertices.push_back((float)(i + chunkOffsetZ * 16)); // NOLINT(bugprone-integer-division)
-        rightChunk->tiles[i * 16].color().appendToVector(vertices);
-        vertices.push_back(1.f);
-    }
-    std::size_t const bottomChunkOffset = vertices.size() / vertexSize;
-    if(bottomChunk.has_value()) for(int i = 0; i < 16; i++) {
-        vertices.push_back((float)(i + chunkOffsetX * 16));
-        // yes I know "% 16" is redundant, but it's consistent
-        // a good compiler will optimize it out anyways
-        vertices.push_back((float)(bottomChunk->tiles[i % 16].height));
-        vertices.push_back((float)(16 + chunkOffsetZ * 16)); // NOLINT(bugprone-integer-division)
-        bottomChunk->tiles[i % 16].color().appendToVector(vertices);
-        vertices.push_back(1.f);
-    }
-    std::size_t const bottomRightChunkOffset = vertices.size() / vertexSize;
-    if(bottomRightChunk.has_value()) {
-        vertices.push_back((float)(16 + chunkOffsetX * 16));
-        vertices.push_back((float)(bottomRightChunk->tiles[0].height));
-        vertices.push_back((float)(16 + chunkOffsetZ * 16)); // NOLINT(bugprone-integer-division)
-        bottomRightChunk->tiles[0].color().appendToVector(vertices);
-        vertices.push_back(1.f);
-    }
-
-    auto vertexData = bgfx::copy(vertices.data(), vertices.size() * sizeof(float));
-    auto indexData = bgfx::makeRef(indices.data(), indices.size() * sizeof(uint32_t));
-    bgfx::VertexLayout layout;
-    layout
-        .begin()
-        .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
-        .add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Float)
-        .end();
+    if(meshLod > 0) {
+        return this->asDecimatedPrimitive(chunkOffsetX, chunkOffsetZ, neighbors, meshLod);
+    }
+
+    // the vertices are written straight into memory bgfx takes ownership of, so there's no
+    // intermediate buffer to fill and then copy
+    auto const vertexData = bgfx::alloc((this->heights.size() + 16 + 16 + 1) * sizeof(TerrainVertex));
+    auto vertex = (TerrainVertex*)vertexData->data;
+    auto const normals = this->computeNormals(neighbors);
+
+    for(int z = 0; z < 16; z++) for(int x = 0; x < 16; x++) {
+        *vertex++ = TerrainVertex::fromTile(x, z, this->tile(z * 16 + x), normals[z * 17 + x]);
+    }
+    for(int z = 0; z < 16; z++) {
+        *vertex++ = TerrainVertex::fromTile(16, z, this->meshTile(16, z, neighbors), normals[z * 17 + 16]);
+    }
+    for(int x = 0; x < 16; x++) {
+        *vertex++ = TerrainVertex::fromTile(x, 16, this->meshTile(x, 16, neighbors), normals[16 * 17 + x]);
+    }
+    *vertex++ = TerrainVertex::fromTile(16, 16, this->meshTile(16, 16, neighbors), normals[16 * 17 + 16]);
+
+    Mat4 chunkTransform;
+    bx::mtxTranslate(chunkTransform.data(), chunkOffsetX * 16, 0.f, chunkOffsetZ * 16);
+
+    this->primitive.emplace(Model::Primitive{
+        .vertexBuffer = bgfx::createDynamicVertexBuffer(vertexData, TerrainVertex::layout()),
+        .indexBuffer = sharedChunkIndexBuffer(),
+        .layout = TerrainVertex::layout(),
+        .transform = chunkTransform,
+        .bounds = this->meshBounds(neighbors),
+    });
+
+    return this->primitive.value();
+}
+
+std::size_t Chunk::borderIndex(int const x, int const z) {
+    // the rows above and below first, then the columns on either side of the rest
+    if(z == -1) return x + 1;
+    if(z == 16) return 19 + x + 1;
+    if(z == 17) return 19 * 2 + x + 1;
+    return 19 * 3 + z * 3 + (x == -1? 0 : x - 15);
+}
+
+Tile Chunk::meshTile(int const x, int const z, ChunkNeighbors const & neighbors) const {
+    int const dx = x < 0? -1 : x >= 16? 1 : 0;
+    int const dz = z < 0? -1 : z >= 16? 1 : 0;
+    if(dx == 0 && dz == 0) return this->tile(z * 16 + x);
+
+    Chunk const * const neighbor = std::array<std::array<Chunk const *, 3>, 3>{{
+        {neighbors.topLeft,    neighbors.top,    neighbors.topRight   },
+        {neighbors.left,       nullptr,          neighbors.right      },
+        {neighbors.bottomLeft, neighbors.bottom, neighbors.bottomRight},
+    }}[dz + 1][dx + 1];
+
+    if(neighbor) return neighbor->tile((z - dz * 16) * 16 + x - dx * 16);
+    return Tile{this->borderHeights[Chunk::borderIndex(x, z)], Tile::Type::Grass};
+}
+
+// (left - right, 2, up - down) is the cross product of the two central differences.
+// Both the mesh and the physics go through this so they can't disagree on a slope
+static Vec3 differencesToNormal(float const nx, float const nz) {
+    return Vec3{nx, 2.f, nz}.normalized();
+}
+
+std::array<PackedNormal, 17 * 17> Chunk::computeNormals(ChunkNeighbors const & neighbors) const {
+    // every height the central differences need, -1 to 17 on both axes. The inside
+    // is copied straight out of the height array, only the ring goes through meshTile
+    std::array<float, 19 * 19> heights;
+    for(int z = -1; z <= 17; z++) for(int x = -1; x <= 17; x++) {
+        if(x >= 0 && x < 16 && z >= 0 && z < 16) continue;
+        heights[(z + 1) * 19 + x + 1] = this->meshTile(x, z, neighbors).height;
+    }
+    for(int z = 0; z < 16; z++) for(int x = 0; x < 16; x++) {
+        heights[(z + 1) * 19 + x + 1] = this->height(z * 16 + x);
+    }
+
+    // kept as plain loops over flat arrays with nothing branching, so they get vectorized
+    std::array<float, 17 * 17> nx;
+    std::array<float, 17 * 17> nz;
+    for(int z = 0; z < 17; z++) {
+        float const * const above = &heights[(z    ) * 19 + 1];
+        float const * const row   = &heights[(z + 1) * 19    ];
+        float const * const below = &heights[(z + 2) * 19 + 1];
+        for(int x = 0; x < 17; x++) {
+            nx[z * 17 + x] = row[x] - row[x + 2];
+            nz[z * 17 + x] = above[x] - below[x];
+        }
+    }
+
+    std::array<PackedNormal, 17 * 17> ret;
+    for(std::size_t i = 0; i < ret.size(); i++) {
+        Vec3 const normal = differencesToNormal(nx[i], nz[i]);
+        ret[i] = {
+            (int16_t)(normal.x * 32767.f),
+            (int16_t)(normal.y * 32767.f),
+            (int16_t)(normal.z * 32767.f),
+            0
+        };
+    }
+
+    return ret;
+}
+
+Vec3 Chunk::vertexNormal(int const x, int const z, ChunkNeighbors const & neighbors) const {
+    return differencesToNormal(
+        this->meshTile(x - 1, z, neighbors).height - this->meshTile(x + 1, z, neighbors).height,
+        this->meshTile(x, z - 1, neighbors).height - this->meshTile(x, z + 1, neighbors).height
+    );
+}
+
+Model::Primitive Chunk::asDecimatedPrimitive(
+    int const chunkOffsetX,
+    int const chunkOffsetZ,
+    ChunkNeighbors const & neighbors,
+    int const lod
+) {
+    auto const & mesh = decimatedMesh(lod);
+
+    auto const vertexData = bgfx::alloc(mesh.vertices.size() * sizeof(TerrainVertex));
+    auto vertex = (TerrainVertex*)vertexData->data;
+    auto const normals = this->computeNormals(neighbors);
+    for(auto const & [x, z]: mesh.vertices) {
+        *vertex++ = TerrainVertex::fromTile(x, z, this->meshTile(x, z, neighbors), normals[z * 17 + x]);
+    }
+
+    Mat4 chunkTransform;
+    bx::mtxTranslate(chunkTransform.data(), chunkOffsetX * 16, 0.f, chunkOffsetZ * 16);
+
+    this->primitiveLod = lod;
 
     this->primitive.emplace(Model::Primitive{
-        .vertexBuffer = bgfx::createVertexBuffer(vertexData, layout),
-        .indexBuffer = bgfx::createIndexBuffer(indexData, BGFX_BUFFER_INDEX32),
-        .layout = layout
+        .vertexBuffer = bgfx::createVertexBuffer(vertexData, TerrainVertex::layout()),
+        .indexBuffer = mesh.indexBuffer,
+        .layout = TerrainVertex::layout(),
+        .transform = chunkTransform,
+        .bounds = this->meshBounds(neighbors),
     });
 
     return this->primitive.value();
 }
 
+Model::Primitive Chunk::asHeightmapPrimitive(
+    int const chunkOffsetX,
+    int const chunkOffsetZ,
+    ChunkNeighbors const & neighbors
+) {
+    Mat4 chunkTransform;
+    bx::mtxTranslate(chunkTransform.data(), chunkOffsetX * 16, 0.f, chunkOffsetZ * 16);
+
+    this->primitive.emplace(Model::Primitive{
+        .vertexBuffer = sharedChunkGridBuffer(),
+        .indexBuffer = sharedChunkIndexBuffer(),
+        .layout = chunkGridLayout(),
+        .transform = chunkTransform,
+        .bounds = this->meshBounds(neighbors),
+        .heightmap = bgfx::createTexture2D(
+            19, 
+            19, 
+            false, 
+            1, 
+            bgfx::TextureFormat::RG16F, 
+            BGFX_SAMPLER_POINT | BGFX_SAMPLER_UVW_CLAMP
+        ),
+    });
+    this->uploadHeightmap(neighbors, 0, 0, 18, 18);
+
+    return this->primitive.value();
+}
+
+void Chunk::uploadHeightmap(
+    ChunkNeighbors const & neighbors,
+    int const minX,
+    int const minZ,
+    int const maxX,
+    int const maxZ
+) {
+    int const width = maxX - minX + 1;
+    int const height = maxZ - minZ + 1;
+
+    auto const texelData = bgfx::alloc(width * height * 2 * sizeof(uint16_t));
+    auto texel = (uint16_t*)texelData->data;
+    for(int z = minZ; z <= maxZ; z++) for(int x = minX; x <= maxX; x++) {
+        auto const tile = this->meshTile(x - 1, z - 1, neighbors);
+        *texel++ = bx::halfFromFloat(tile.height);
+        *texel++ = bx::halfFromFloat((float)tile.type);
+    }
+
+    bgfx::updateTexture2D(this->primitive->heightmap.value(), 0, 0, minX, minZ, width, height, texelData);
+}
+
+std::size_t Chunk::vertexIndex(int const x, int const z) const {
+    // same order asPrimitive writes them in
+    if(x < 16 && z < 16) {
+        return z * 16 + x;
+    } else if(z < 16) {
+        return 256 + z;
+    } else if(x < 16) {
+        return 256 + 16 + x;
+    } else {
+        return 256 + 16 + 16;
+    }
+}
+
+AABB Chunk::meshBounds(ChunkNeighbors const & neighbors) const {
+    // the stored heights sort the same as the real ones, so only the two ends need converting
+    auto const [minStored, maxStored] = std::minmax_element(this->heights.begin(), this->heights.end());
+    float minHeight = this->height(minStored - this->heights.begin());
+    float maxHeight = this->height(maxStored - this->heights.begin());
+    for(int i = 0; i <= 16; i++) {
+        for(auto const height: {
+            this->meshTile(16, i, neighbors).height,
+            this->meshTile(i, 16, neighbors).height,
+        }) {
+            minHeight = std::min(minHeight, height);
+            maxHeight = std::max(maxHeight, height);
+        }
+    }
+
+    return {
+        .min = {0.f, minHeight, 0.f},
+        .max = {16.f, maxHeight, 16.f},
+    };
+}
+
+void Chunk::markVerticesDirty(int const minX, int const minZ, int const maxX, int const maxZ) {
+    if(!this->primitive.has_value()) return;
+
+    this->dirtyMinX = std::min(this->dirtyMinX, minX);
+    this->dirtyMinZ = std::min(this->dirtyMinZ, minZ);
+    this->dirtyMaxX = std::max(this->dirtyMaxX, maxX);
+    this->dirtyMaxZ = std::max(this->dirtyMaxZ, maxZ);
+}
+
+void Chunk::uploadDirtyVertices(ChunkNeighbors const & neighbors) {
+    if(!this->hasDirtyVertices()) return;
+
+    auto const normals = this->computeNormals(neighbors);
+
+    // the rectangle isn't contiguous in the vertex buffer (and the seams are tacked on at
+    // the end), so it gets split up into however many runs of vertices it covers
+    std::vector<std::tuple<std::size_t, int, int>> dirtyVertices;
+    dirtyVertices.reserve((this->dirtyMaxX - this->dirtyMinX + 1) * (this->dirtyMaxZ - this->dirtyMinZ + 1));
+    for(int z = this->dirtyMinZ; z <= this->dirtyMaxZ; z++) for(int x = this->dirtyMinX; x <= this->dirtyMaxX; x++) {
+        dirtyVertices.push_back({this->vertexIndex(x, z), x, z});
+    }
+    std::sort(dirtyVertices.begin(), dirtyVertices.end());
+
+    for(auto runStart = dirtyVertices.begin(); runStart != dirtyVertices.end();) {
+        auto runEnd = runStart + 1;
+        while(runEnd != dirtyVertices.end() && std::get<0>(*runEnd) == std::get<0>(*(runEnd - 1)) + 1) runEnd++;
+
+        auto const vertexData = bgfx::alloc((runEnd - runStart) * sizeof(TerrainVertex));
+        auto vertex = (TerrainVertex*)vertexData->data;
+        for(auto it = runStart; it != runEnd; it++) {
+            auto const [_, x, z] = *it;
+            *vertex++ = TerrainVertex::fromTile(x, z, this->meshTile(x, z, neighbors), normals[z * 17 + x]);
+        }
+
+        bgfx::update(
+            std::get<bgfx::DynamicVertexBufferHandle>(this->primitive.value().vertexBuffer),
+            std::get<0>(*runStart),
+            vertexData
+        );
+
+        runStart = runEnd;
+    }
+
+    this->primitive->bounds = this->meshBounds(neighbors);
+    this->resetDirtyVertices();
+}
+
+void Chunk::resetDirtyVertices() {
+    this->dirtyMinX = 17;
+    this->dirtyMinZ = 17;
+    this->dirtyMaxX = -1;
+    this->dirtyMaxZ = -1;
+}
+
+bool Chunk::hasDirtyVertices() const {
+    return this->dirtyMinX <= this->dirtyMaxX && this->dirtyMinZ <= this->dirtyMaxZ;
+}
+
+bool Chunk::needsMeshing(int const lod) const {
+    // there's only ever the one level of detail with heightmaps
+    if(useHeightmapTerrain()) return !this->primitive.has_value();
+
+    return !this->primitive.has_value() || this->primitiveLod != std::clamp(lod, 0, MAX_LOD);
+}
+
+std::optional<Model::Primitive> const & Chunk::cachedPrimitive() const {
+    return this->primitive;
+}
+
 void Chunk::unloadPrimitive() {
-    if(this->primitive.has_value()
-    && bgfx::isValid(this->primitive.value().vertexBuffer)
-    && bgfx::isValid(this->primitive.value().indexBuffer)
-    ) {
-        this->primitive.value().destroy();
+    if(this->primitive.has_value()) {
+        // not Primitive::destroy, the index buffer is shared between every chunk
+        // (and so is the vertex buffer if it's drawn with a heightmap)
+        if(this->primitive->heightmap.has_value()) {
+            bgfx::destroy(this->primitive->heightmap.value());
+        } else {
+            std::visit([](auto const handle){ bgfx::destroy(handle); }, this->primitive.value().vertexBuffer);
+        }
         this->primitive.reset();
-        this->primitiveGenerationState = 0;
+        this->primitiveLod = 0;
+        this->resetDirtyVertices();
     }
 }
 
-std::weak_ptr<Model> World::updateModel(int cx, int cz, int renderDistance) {
+std::weak_ptr<Model> World::updateModel(int cx, int cz, int renderDistance, Vec3 facing) {
+    bool const moved = cx != this->oldCx || cz != this->oldCz || renderDistance != this->oldRenderDistance;
+
     if(
         this->outdatedChunks.size() > 0
-     || cx != this->oldCx
-     || cz != this->oldCz
-     || renderDistance != this->oldRenderDistance
+     || moved
+     || !this->streamingRequests.empty()
+     || this->meshingIncomplete
      || !this->model.has_value()
     ) {
+        auto const deadline = std::chrono::steady_clock::now() 
+            + std::chrono::microseconds((int64_t)(config.world.streamingBudget * 1000));
+
+        // anything that went out of range is dropped along with the old requests
+        if(moved) this->requestChunks(cx, cz, renderDistance, facing);
+
         if(this->model.has_value()) {
-            *this->model.value() = this->asModel(cx, cz, renderDistance, renderDistance + 2);
+            *this->model.value() = this->asModel(cx, cz, renderDistance, renderDistance + 2, deadline);
         } else {
-            this->model = std::make_optional(std::make_shared<Model>(this->asModel(cx, cz, renderDistance, renderDistance + 2)));
+            this->model = std::make_optional(std::make_shared<Model>(this->asModel(cx, cz, renderDistance, renderDistance + 2, deadline)));
         }
+        // something about the terrain changed, so its shadow needs redrawing
+        rendererState.staticShadowsDirty = true;
+
+        this->saveChunks();
+        this->evictChunks(cx, cz, renderDistance + 2);
         this->oldCx = cx;
         this->oldCz = cz;
         this->oldRenderDistance = renderDistance;
@@ -315,30 +823,46 @@ std::weak_ptr<Model> World::updateModel(int cx, int cz, int renderDistance) {
     return this->model.value();
 }
 
-Model World::asModel(int cx, int cz, int renderDistance, int unloadDistance) {
+Model World::asModel(
+    int cx, 
+    int cz, 
+    int renderDistance, 
+    int unloadDistance, 
+    std::chrono::steady_clock::time_point deadline
+) {
     std::vector<Model::Primitive> primitives;
     primitives.reserve((renderDistance * 2 + 1) * (renderDistance * 2 + 1));
 
-    this->loadChunks(cx, cz, renderDistance);
+    this->streamChunks(deadline);
     this->unloadChunks(cx, cz, unloadDistance);
 
     outdatedChunks.clear();
+    this->chunkUseCounter++;
+    this->meshingIncomplete = false;
 
     for(int i = cx - renderDistance; i < cx + renderDistance; i++)
         for(int j = cz - renderDistance; j < cz + renderDistance; j++) {
-            std::optional<Chunk> rightChunk = chunks.contains({i + 1, j})?
-                std::make_optional(chunks.at({i + 1, j}))
-                    :
-                std::nullopt;
-            std::optional<Chunk> bottomChunk = chunks.contains({i, j + 1})?
-                std::make_optional(chunks.at({i, j + 1}))
-                    :
-                std::nullopt;
-            std::optional<Chunk> bottomRightChunk = chunks.contains({i + 1, j + 1})?
-                std::make_optional(chunks.at({i + 1, j + 1}))
+            auto const distance = std::max(std::abs(i - cx), std::abs(j - cz));
+            auto const lod = config.graphics.terrainLodDistance > 0?
+                std::min<int>(distance / config.graphics.terrainLodDistance, Chunk::MAX_LOD)
                     :
-                std::nullopt;
-            primitives.push_back(chunks.at({i, j}).asPrimitive(i, j, rightChunk, bottomChunk, bottomRightChunk));
+                0;
+
+            // not streamed in yet
+            auto found = chunks.find({i, j});
+            if(found == chunks.end() || found->second.isSkeleton) continue;
+
+            auto& chunk = found->second;
+            chunk.lastUsed = this->chunkUseCounter;
+
+            // out of time, so whatever mesh it already has will do until next update
+            if(chunk.needsMeshing(lod) && std::chrono::steady_clock::now() > deadline) {
+                this->meshingIncomplete = true;
+                if(chunk.cachedPrimitive().has_value()) primitives.push_back(chunk.cachedPrimitive().value());
+                continue;
+            }
+
+            primitives.push_back(chunk.asPrimitive(i, j, this->neighborsOf(i, j), lod));
         }
 
     return Model{
@@ -346,44 +870,70 @@ Model World::asModel(int cx, int cz, int renderDistance, int unloadDistance) {
     };
 }
 
-void World::loadChunks(int cx, int cz, int renderDistance) {
-    std::set<std::tuple<int, int>> skeletonChunkRequests;
-    std::vector<std::function<void()>> decorators;
+void World::requestChunks(int cx, int cz, int renderDistance, Vec3 facing) {
+    facing.y = 0.f;
+    if(facing.lengthSquared() > 0.f) facing = facing.normalized();
 
+    std::vector<std::tuple<float, std::pair<int, int>>> requests;
     for(int i = cx - renderDistance; i < cx + renderDistance; i++) {
         for(int j = cz - renderDistance; j < cz + renderDistance; j++) {
-            if(!chunks.contains({i, j})) {
-                chunks.emplace(std::make_pair(i, j), Chunk::generateSkeleton(i, j, this->worldSeed));
-            }
+            if(auto found = chunks.find({i, j}); found != chunks.end() && !found->second.isSkeleton) continue;
 
-            if(chunks[{i, j}].isSkeleton) {
-                chunks[{i, j}].finishGeneration(
-                    i, 
-                    j, 
-                    this->worldSeed, 
-                    this->patterns, 
-                    skeletonChunkRequests, 
-                    decorators
-                );
-            }
+            Vec3 const offset{(float)(i - cx), 0.f, (float)(j - cz)};
+            auto const distance = offset.length();
+            auto const facingAmount = distance > 0.f? offset.dot(facing) / distance : 0.f;
+
+            // straight ahead counts as it is, straight behind counts as twice as far
+            requests.push_back({distance * (1.5f - 0.5f * facingAmount), {i, j}});
         }
     }
+    std::sort(requests.begin(), requests.end(), std::greater<>());
 
-    for(auto [scrX, scrZ]: skeletonChunkRequests) {
-        chunks.emplace(std::make_pair(scrX, scrZ), Chunk::generateSkeleton(scrX, scrZ, this->worldSeed));
-    }
+    this->streamingRequests.clear();
+    this->streamingRequests.reserve(requests.size());
+    for(auto const & [_, coord]: requests) this->streamingRequests.push_back(coord);
+}
 
-    for(auto decorator: decorators) {
-        decorator();
-    }
+void World::streamChunks(std::chrono::steady_clock::time_point deadline) {
+    // always at least one, so it keeps moving even if the budget is tiny
+    do {
+        if(this->streamingRequests.empty()) break;
+
+        auto const [i, j] = this->streamingRequests.back();
+        this->streamingRequests.pop_back();
+
+        auto& chunk = this->loadChunk(i, j);
+        if(!chunk.isSkeleton) continue;
+
+        std::set<std::tuple<int, int>> skeletonChunkRequests;
+        std::vector<DecorationJob> decorations;
+        chunk.finishGeneration(
+            i, 
+            j, 
+            this->worldSeed, 
+            this->patterns, 
+            skeletonChunkRequests, 
+            decorations
+        );
+        this->unsavedChunks.insert({i, j});
+
+        for(auto [scrX, scrZ]: skeletonChunkRequests) {
+            this->loadChunk(scrX, scrZ);
+        }
+
+        for(auto const & [pattern, x, z]: decorations) {
+            pattern->decorate(x, z);
+        }
+        // after every decorator, so they're placed on the finished tiles
+        this->populateChunk(chunk, decorations);
+    } while(std::chrono::steady_clock::now() < deadline);
 }
 
 void World::unloadChunks(int cx, int cz, int unloadDistance) {
     for(auto & [coord, chunk]: chunks) {
         auto [x, z] = coord;
         if(
-            outdatedChunks.contains({x, z})
-         || x < cx - unloadDistance
+            x < cx - unloadDistance
          || x > cx + unloadDistance
          || z < cz - unloadDistance
          || z > cz + unloadDistance
@@ -393,6 +943,145 @@ void World::unloadChunks(int cx, int cz, int unloadDistance) {
     }
 }
 
+void World::evictChunks(int cx, int cz, int keepDistance) {
+    std::size_t const budget = config.world.chunkMemoryBudget * 1024 * 1024;
+    // the decorations are the only part of a chunk that isn't a fixed size
+    auto const chunkMemoryUsage = [](Chunk const & chunk){
+        return sizeof(Chunk) + chunk.decorations.capacity() * sizeof(Decoration);
+    };
+
+    std::size_t loadedMemoryUsage = 0;
+    for(auto const & [_, chunk]: chunks) loadedMemoryUsage += chunkMemoryUsage(chunk);
+    auto const memoryUsage = [&](){
+        return loadedMemoryUsage + this->evictedChunksMemoryUsage;
+    };
+
+    if(memoryUsage() <= budget) return;
+
+    std::vector<std::tuple<uint64_t, std::pair<int, int>>> candidates;
+    for(auto const & [coord, chunk]: chunks) {
+        auto [x, z] = coord;
+        if(std::abs(x - cx) > keepDistance || std::abs(z - cz) > keepDistance) {
+            candidates.push_back({chunk.lastUsed, coord});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for(auto const & [_, coord]: candidates) {
+        if(memoryUsage() <= budget) break;
+
+        auto& chunk = chunks.at(coord);
+        chunk.unloadPrimitive();
+        // already saved by now, it'll just get loaded back from the region store
+        if(chunk.edited && !this->regionStore) {
+            auto delta = chunk.asDelta(coord.first, coord.second, this->worldSeed);
+            this->evictedChunksMemoryUsage += delta.memoryUsage();
+            this->evictedChunks.insert_or_assign(coord, std::move(delta));
+        }
+        loadedMemoryUsage -= chunkMemoryUsage(chunk);
+        chunks.erase(coord);
+    }
+}
+
+Chunk& World::loadChunk(int x, int z) {
+    if(auto found = chunks.find({x, z}); found != chunks.end()) {
+        return found->second;
+    }
+
+    if(auto evicted = evictedChunks.find({x, z}); evicted != evictedChunks.end()) {
+        auto& chunk = chunks.emplace(std::make_pair(x, z), Chunk::fromDelta(x, z, this->worldSeed, evicted->second)).first->second;
+        this->evictedChunksMemoryUsage -= evicted->second.memoryUsage();
+        evictedChunks.erase(evicted);
+        if(!chunk.isSkeleton) {
+            this->populateChunk(chunk, Chunk::decorationSites(x, z, this->worldSeed, this->patterns));
+        }
+        // the neighbors' seams and normals were meshed with this chunk's skeleton heights
+        this->markTilesDirty(x * 16, z * 16, x * 16 + 15, z * 16 + 15);
+        return chunk;
+    }
+
+    if(this->regionStore) if(auto saved = this->regionStore->load(x, z)) {
+        auto& chunk = chunks.emplace(std::make_pair(x, z), saved.value()).first->second;
+
+        if(!chunk.isSkeleton) {
+            this->populateChunk(chunk, Chunk::decorationSites(x, z, this->worldSeed, this->patterns));
+        }
+
+        this->markTilesDirty(x * 16, z * 16, x * 16 + 15, z * 16 + 15);
+        return chunk;
+    }
+
+    return chunks.emplace(std::make_pair(x, z), Chunk::generateSkeleton(x, z, this->worldSeed)).first->second;
+}
+
+void World::populateChunk(Chunk& chunk, std::vector<DecorationJob> const & sites) {
+    chunk.decorations.clear();
+    for(auto const & [pattern, x, z]: sites) {
+        if(pattern->populate) pattern->populate(x, z, chunk.decorations);
+    }
+
+    std::stable_sort(chunk.decorations.begin(), chunk.decorations.end(), [](auto const & a, auto const & b) {
+        return a.model < b.model;
+    });
+    chunk.decorations.shrink_to_fit();
+}
+
+uint16_t World::decorationModelId(std::weak_ptr<Model const> const & model) {
+    auto const locked = model.lock();
+    for(std::size_t i = 0; i < this->decorationModels.size(); i++) {
+        if(this->decorationModels[i].lock() == locked) return i;
+    }
+
+    this->decorationModels.push_back(model);
+    return this->decorationModels.size() - 1;
+}
+
+void World::drawDecorations() const {
+    std::vector<Mat4> orientations;
+
+    for(int cz = this->oldCz - this->oldRenderDistance; cz <= this->oldCz + this->oldRenderDistance; cz++) {
+        for(int cx = this->oldCx - this->oldRenderDistance; cx <= this->oldCx + this->oldRenderDistance; cx++) {
+            auto found = chunks.find({cx, cz});
+            if(found == chunks.end()) continue;
+            auto const & decorations = found->second.decorations;
+
+            for(auto run = decorations.begin(); run != decorations.end();) {
+                auto const runEnd = std::find_if(run, decorations.end(), [&](auto const & decoration) {
+                    return decoration.model != run->model;
+                });
+
+                orientations.clear();
+                for(auto it = run; it != runEnd; it++) {
+                    Mat4 orientation;
+                    bx::mtxRotateY(orientation.data(), it->yaw);
+                    orientation[12] = it->position.x;
+                    orientation[13] = it->position.y;
+                    orientation[14] = it->position.z;
+                    orientations.push_back(orientation);
+                }
+                drawModelInstanced(this->decorationModels[run->model], orientations, true);
+
+                run = runEnd;
+            }
+        }
+    }
+}
+
+void World::saveChunks() {
+    if(!this->regionStore) return;
+
+    for(auto const & coord: this->unsavedChunks) {
+        auto found = chunks.find(coord);
+        if(found == chunks.end()) continue;
+        auto const & chunk = found->second;
+
+        if(!chunk.isSkeleton || chunk.edited) {
+            this->regionStore->save(coord.first, coord.second, chunk);
+        }
+    }
+    this->unsavedChunks.clear();
+}
+
 bool World::withinRenderDistance(ModelInstance const & mod) const {
     // using the old render distance values because I'm lazy
     // they get updated frequently anyways
@@ -403,51 +1092,61 @@ bool World::withinRenderDistance(ModelInstance const & mod) const {
         && dz <= oldRenderDistance;
 }
 
-Tile* World::getTileMut(int x, int z) {
-    auto xdiv = std::div(x, 16);
-    if(xdiv.rem < 0) {
-        xdiv.rem += 16;
-        xdiv.quot -= 1;
-    }
-    auto zdiv = std::div(z, 16);
-    if(zdiv.rem < 0) {
-        zdiv.rem += 16;
-        zdiv.quot -= 1;
-    }
+void World::markTilesDirty(int const minX, int const minZ, int const maxX, int const maxZ) {
+    // normals use the tiles on either side, so one more tile around the edit is affected
+    int const affectedMinX = minX - 1;
+    int const affectedMinZ = minZ - 1;
+    int const affectedMaxX = maxX + 1;
+    int const affectedMaxZ = maxZ + 1;
+
+    // every chunk with a vertex in there, seams included (a chunk's vertices go from 0 to 16)
+    auto const [minCx, _minTx] = floorDivMod(affectedMinX - 1, 16);
+    auto const [minCz, _minTz] = floorDivMod(affectedMinZ - 1, 16);
+    auto const [maxCx, _maxTx] = floorDivMod(affectedMaxX, 16);
+    auto const [maxCz, _maxTz] = floorDivMod(affectedMaxZ, 16);
+
+    for(int cz = minCz; cz <= maxCz; cz++) for(int cx = minCx; cx <= maxCx; cx++) {
+        auto found = chunks.find({cx, cz});
+        if(found == chunks.end()) continue;
 
-    if(!chunks.contains({xdiv.quot, zdiv.quot})) {
-        return nullptr;
+        found->second.markVerticesDirty(
+            std::max(affectedMinX - cx * 16, 0 ),
+            std::max(affectedMinZ - cz * 16, 0 ),
+            std::min(affectedMaxX - cx * 16, 16),
+            std::min(affectedMaxZ - cz * 16, 16)
+        );
+        outdatedChunks.insert({cx, cz});
     }
+}
 
-    // if the caller is using the mutable version, then it's probably getting mutated
-    // therefor this chunk is likely outdated (and adjacent ones if it's on the edge)
-    // TODO: deal with corners too
-    outdatedChunks.insert({xdiv.quot, zdiv.quot});
-    if(xdiv.rem == 0 ) outdatedChunks.insert({xdiv.quot - 1, zdiv.quot     });
-    if(xdiv.rem == 15) outdatedChunks.insert({xdiv.quot + 1, zdiv.quot     });
-    if(zdiv.rem == 0 ) outdatedChunks.insert({xdiv.quot    , zdiv.quot  - 1});
-    if(zdiv.rem == 15) outdatedChunks.insert({xdiv.quot    , zdiv.quot  + 1});
+ChunkNeighbors World::neighborsOf(int const cx, int const cz) const {
+    auto const neighbor = [&](int const x, int const z) -> Chunk const * {
+        auto found = chunks.find({x, z});
+        return found != chunks.end()? &found->second : nullptr;
+    };
 
-    return &chunks.at({xdiv.quot, zdiv.quot}).tiles[zdiv.rem * 16 + xdiv.rem];
+    return ChunkNeighbors{
+        .topLeft     = neighbor(cx - 1, cz - 1),
+        .top         = neighbor(cx    , cz - 1),
+        .topRight    = neighbor(cx + 1, cz - 1),
+        .left        = neighbor(cx - 1, cz    ),
+        .right       = neighbor(cx + 1, cz    ),
+        .bottomLeft  = neighbor(cx - 1, cz + 1),
+        .bottom      = neighbor(cx    , cz + 1),
+        .bottomRight = neighbor(cx + 1, cz + 1),
+    };
 }
 
-Tile const * World::getTile(int x, int z) const {
-    auto xdiv = std::div(x, 16);
-    if(xdiv.rem < 0) {
-        xdiv.rem += 16;
-        xdiv.quot -= 1;
-    }
-    auto zdiv = std::div(z, 16);
-    if(zdiv.rem < 0) {
-        zdiv.rem += 16;
-        zdiv.quot -= 1;
-    }
+std::optional<Tile> World::getTile(int x, int z) const {
+    auto const [cx, tx] = floorDivMod(x, 16);
+    auto const [cz, tz] = floorDivMod(z, 16);
 
-    if(!chunks.contains({xdiv.quot, zdiv.quot})) {
-        return nullptr;
+    auto found = chunks.find({cx, cz});
+    if(found == chunks.end()) {
+        return std::nullopt;
     }
 
-    return &chunks.at({xdiv.quot, zdiv.quot}).tiles[zdiv.rem * 16 + xdiv.rem];
+    return found->second.tile(tz * 16 + tx);
 }
 
 std::optional<float> World::sampleHeight(float x, float z) {
@@ -473,17 +1172,30 @@ std::optional<float> World::sampleHeight(float x, float z) {
 }
 
 std::optional<Vec3> World::getWorldNormal(float x, float z) {
-    // would look a lot simpler with rust's '?' operator
-    auto c = sampleHeight(x, z);
-    auto a = sampleHeight(x, z + 0.1f);
-    auto b = sampleHeight(x + 0.1f, z);
+    auto [ix, rx] = floorFract(x);
+    auto [iz, rz] = floorFract(z);
 
-    if(c && a && b) {
-        auto o =  Vec3{x       , c.value(), z       };
-        auto pa = Vec3{x       , a.value(), z + 0.1f};
-        auto pb = Vec3{x + 0.1f, b.value(), z       };
+    // normal of the vertex on top of a tile, from the stored heights so skeletons have one too
+    auto const vertexNormal = [&](int const x, int const z) -> std::optional<Vec3> {
+        auto const [cx, tx] = floorDivMod(x, 16);
+        auto const [cz, tz] = floorDivMod(z, 16);
 
-        return ((pa - o).cross(pb - o)).normalized();
+        auto found = chunks.find({cx, cz});
+        if(found == chunks.end()) return std::nullopt;
+        return found->second.vertexNormal(tx, tz, this->neighborsOf(cx, cz));
+    };
+
+    auto r00 = vertexNormal(ix    , iz    );
+    auto r01 = vertexNormal(ix    , iz + 1);
+    auto r10 = vertexNormal(ix + 1, iz    );
+    auto r11 = vertexNormal(ix + 1, iz + 1);
+
+    if(r00 && r01 && r10 && r11) {
+        return Vec3{
+            interpolate(r00->x, r01->x, r10->x, r11->x, rx, rz),
+            interpolate(r00->y, r01->y, r10->y, r11->y, rx, rz),
+            interpolate(r00->z, r01->z, r10->z, r11->z, rx, rz),
+        }.normalized();
     } else {
         return std::nullopt;
     }
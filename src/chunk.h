@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <chrono>
 #include <memory>
 #include <set>
 
@@ -8,63 +11,359 @@
 #include "modelInstance.h"
 #include "entitySystem.h"
 #include "mathUtils.h"
+#include "regionStore.h"
 
 EntityId createWorldEntity();
 
 struct Tile {
     float height;
-    enum Type {
+    enum Type : uint8_t {
         Grass,
         Dirt,
         Blasted,
     }; Type type;
 
+    struct PaletteEntry {
+        RGB<float> offset;
+        // how much the color changes per unit of height
+        RGB<float> heightScale;
+    };
+    // indexed by Type. The terrain shaders get the same thing as a uniform
+    static constexpr std::array<PaletteEntry, 3> palette = {{
+        {.offset = {0.05f, 0.7f, 0.02f}, .heightScale = {0.01f, 0.02f, 0.01f}}, // Grass
+        {.offset = {0.5f,  0.4f, 0.2f }, .heightScale = {0.f,   0.f,   0.f  }}, // Dirt
+        {.offset = {0.23f, 0.23f, 0.23f}, .heightScale = {0.f,  0.f,   0.f  }}, // Blasted
+    }};
+
     constexpr RGB<float> color() const;
 };
 
+// x, y, z scaled to the full range of an int16, the 4th is padding
+using PackedNormal = std::array<int16_t, 4>;
+
+/**
+ * @brief The vertex format of chunk meshes
+ * Positions are local to the chunk (the chunk's offset is put in the primitive's
+ * transform), so they're small enough to be stored as halfs without any real loss
+ */
+struct TerrainVertex {
+    uint16_t x;
+    uint16_t height;
+    uint16_t z;
+    uint16_t padding;
+    PackedNormal normal;
+    uint32_t color; // ABGR, one byte per channel
+
+    static TerrainVertex fromTile(int const x, int const z, Tile const & tile, PackedNormal const & normal);
+
+    static bgfx::VertexLayout const & layout();
+};
+
+/**
+ * @brief Something static that sits on a chunk (i.e. a tree)
+ * Kept in the chunk instead of being an entity, and drawn instanced
+ * with everything else in the chunk that has the same model
+ */
+struct Decoration {
+    Vec3 position;
+    float yaw;
+    // index into World::decorationModels
+    uint16_t model;
+};
+
 struct DecoratorPattern {
     int radius;
     float chance;
     std::size_t seedOffset;
+    // changes the tiles. Only ever runs once per decoration, the result gets saved with the chunk
     void (*decorate)(int x, int z);
+    // adds anything that isn't part of the tiles to the chunk's decorations. Those aren't
+    // saved, so this runs again whenever the chunk is loaded back in
+    void (*populate)(int x, int z, std::vector<Decoration>& out) = nullptr;
+};
+
+// a pattern placed somewhere, in world coordinates
+struct DecorationJob {
+    DecoratorPattern const * pattern;
+    int x;
+    int z;
+};
+
+struct Chunk;
+struct ChunkDelta;
+
+/**
+ * @brief The chunks around one that's being meshed
+ * Any of them can be nullptr if they aren't loaded
+ */
+struct ChunkNeighbors {
+    Chunk const * topLeft;
+    Chunk const * top;
+    Chunk const * topRight;
+    Chunk const * left;
+    Chunk const * right;
+    Chunk const * bottomLeft;
+    Chunk const * bottom;
+    Chunk const * bottomRight;
 };
 
 struct Chunk {
-    std::array<Tile, 16 * 16> tiles;
+#ifdef QUANTIZE_TILE_HEIGHTS
+    // fixed point, HEIGHT_SCALE steps per unit
+    using StoredHeight = int16_t;
+    static constexpr float HEIGHT_SCALE = 128.f;
+#else
+    using StoredHeight = float;
+#endif
+
+    // the tiles are split into their heights and types, so anything that only
+    // needs the heights (which is most things) doesn't have to go through the types too
+    std::array<StoredHeight, 16 * 16> heights;
+    std::array<Tile::Type, 16 * 16> types;
+    // skeleton heights of the ring of tiles around this chunk, one wide on the top/left and
+    // two on the bottom/right (see borderIndex). Lets the seams and the normals along the edges
+    // be meshed without the neighbors being loaded
+    std::array<float, 19 * 19 - 16 * 16> borderHeights;
+    // sorted by model, so each model's instances are next to each other
+    std::vector<Decoration> decorations;
 
     bool isSkeleton = true;
+    // whether this chunk would come out any different if it was regenerated
+    bool edited = false;
+    // when this chunk was last in render distance, for evicting the least recently used ones
+    uint64_t lastUsed = 0;
+
+    static int const MAX_LOD = 3;
+
+    float height(std::size_t const index) const {
+#ifdef QUANTIZE_TILE_HEIGHTS
+        return this->heights[index] / HEIGHT_SCALE;
+#else
+        return this->heights[index];
+#endif
+    }
+
+    void setHeight(std::size_t const index, float const height) {
+#ifdef QUANTIZE_TILE_HEIGHTS
+        this->heights[index] = (int16_t)std::clamp(std::round(height * HEIGHT_SCALE), -32768.f, 32767.f);
+#else
+        this->heights[index] = height;
+#endif
+    }
 
+    Tile tile(std::size_t const index) const {
+        return Tile{this->height(index), this->types[index]};
+    }
+
+    void setTile(std::size_t const index, Tile const & tile) {
+        this->setHeight(index, tile.height);
+        this->types[index] = tile.type;
+    }
+
+    /**
+     * @brief Gets this chunk's mesh, only rebuilding it if it needs to be
+     * Neighbors showing up or going away doesn't change anything, the seams use
+     * borderHeights when they're not loaded
+     * 
+     * @param chunkOffsetX 
+     * @param chunkOffsetZ 
+     * @param neighbors 
+     * @param lod 0 is every tile, 1 to MAX_LOD halves the resolution each level. The edges
+     * of the chunk always keep every tile, so neighbors with different levels still line up.
+     * Ignored if config.graphics.heightmapTerrain is on
+     * @return Model::Primitive 
+     */
     Model::Primitive asPrimitive(
         int chunkOffsetX,
         int chunkOffsetZ,
-        std::optional<Chunk> rightChunk,
-        std::optional<Chunk> bottomChunk,
-        std::optional<Chunk> bottomRightChunk
+        ChunkNeighbors const & neighbors,
+        int lod = 0
     );
 
     void unloadPrimitive();
 
+    /**
+     * @brief Whether asPrimitive would have to build a whole new mesh, rather than
+     * reusing or patching the one it has
+     */
+    bool needsMeshing(int const lod) const;
+
+    std::optional<Model::Primitive> const & cachedPrimitive() const;
+
+    /**
+     * @brief Marks a rectangle of this chunk's mesh as needing to be re-uploaded
+     * Gets merged with whatever was already marked. Does nothing if the chunk isn't meshed
+     * 
+     * Coordinates are chunk local and inclusive, 16 being the seams with the right/bottom chunks
+     */
+    void markVerticesDirty(int const minX, int const minZ, int const maxX, int const maxZ);
+
     static Chunk generateSkeleton(
         int chunkX, 
         int chunkZ, 
         int seed
     );
 
+    /**
+     * @brief Gets how this chunk differs from a freshly generated skeleton
+     * 
+     * @param chunkX 
+     * @param chunkZ 
+     * @param seed 
+     * @return ChunkDelta 
+     */
+    ChunkDelta asDelta(int chunkX, int chunkZ, int seed) const;
+
+    /**
+     * @brief Rebuilds a chunk that was evicted with asDelta
+     * 
+     * @param chunkX 
+     * @param chunkZ 
+     * @param seed 
+     * @param delta 
+     * @return Chunk 
+     */
+    static Chunk fromDelta(int chunkX, int chunkZ, int seed, ChunkDelta const & delta);
+
+    /**
+     * @brief Gets where the patterns get placed in a chunk
+     * Only depends on the seed, so it's the same whether the chunk is being generated or loaded.
+     * Every tile is a candidate with the pattern's chance, and a candidate is placed as long as
+     * there isn't another one in the radius x radius square starting at it
+     * 
+     * @param chunkX 
+     * @param chunkZ 
+     * @param seed 
+     * @param patterns 
+     * @return std::vector<DecorationJob> pointing into patterns
+     */
+    static std::vector<DecorationJob> decorationSites(
+        int chunkX,
+        int chunkZ,
+        int seed,
+        std::vector<DecoratorPattern> const & patterns
+    );
+
+    /**
+     * @brief Marks this chunk as generated, and gets what's needed to decorate it
+     * 
+     * @param chunkX 
+     * @param chunkZ 
+     * @param seed 
+     * @param patterns 
+     * @param outSkeletonChunkRequests the chunks around this one the decorations reach into
+     * @param outDecorations appended to, pointing into patterns
+     */
     void finishGeneration(
         int chunkX, 
         int chunkZ, 
         int seed, 
-        std::vector<DecoratorPattern> patterns,
+        std::vector<DecoratorPattern> const & patterns,
         std::set<std::tuple<int, int>>& outSkeletonChunkRequests,
-        std::vector<std::function<void()>>& outDecorators
+        std::vector<DecorationJob>& outDecorations
     );
 
+    /**
+     * @brief Works out the normal of a single vertex, the same way computeNormals does
+     * 
+     * @param x chunk local, 0 to 16
+     * @param z chunk local, 0 to 16
+     * @param neighbors 
+     * @return Vec3 normalized
+     */
+    Vec3 vertexNormal(int const x, int const z, ChunkNeighbors const & neighbors) const;
+
 private:
     std::optional<Model::Primitive> primitive = std::nullopt;
-    uint8_t primitiveGenerationState = 0;
-    uint8_t const GENERATION_STATE_RIGHT_FINISHED =        0b0000'0001;
-    uint8_t const GENERATION_STATE_BOTTOM_FINISHED =       0b0000'0010;
-    uint8_t const GENERATION_STATE_BOTTOM_RIGHT_FINISHED = 0b0000'0100;
+    int primitiveLod = 0;
+
+    // rectangle of vertices that have been edited since the mesh was last uploaded
+    int dirtyMinX = 17;
+    int dirtyMinZ = 17;
+    int dirtyMaxX = -1;
+    int dirtyMaxZ = -1;
+
+    void resetDirtyVertices();
+    bool hasDirtyVertices() const;
+
+    Model::Primitive asDecimatedPrimitive(
+        int chunkOffsetX,
+        int chunkOffsetZ,
+        ChunkNeighbors const & neighbors,
+        int lod
+    );
+
+    /**
+     * @brief Builds a primitive out of the shared grid and a new heightmap of this chunk
+     * The heightmap is 19 x 19, with the same ring around the chunk as borderHeights
+     */
+    Model::Primitive asHeightmapPrimitive(
+        int chunkOffsetX,
+        int chunkOffsetZ,
+        ChunkNeighbors const & neighbors
+    );
+
+    /**
+     * @brief Uploads a rectangle of this chunk's heightmap
+     * 
+     * @param neighbors 
+     * @param minX texel coordinates, inclusive. Texel (0, 0) is tile (-1, -1)
+     * @param minZ 
+     * @param maxX 
+     * @param maxZ 
+     */
+    void uploadHeightmap(ChunkNeighbors const & neighbors, int const minX, int const minZ, int const maxX, int const maxZ);
+
+    std::size_t vertexIndex(int const x, int const z) const;
+
+    static std::size_t borderIndex(int const x, int const z);
+
+    /**
+     * @brief Gets a tile in or around this chunk for meshing
+     * 
+     * @param x chunk local, -1 to 17
+     * @param z chunk local, -1 to 17
+     * @param neighbors 
+     * @return Tile. From the neighbor if it's loaded, otherwise made up from borderHeights
+     */
+    Tile meshTile(int const x, int const z, ChunkNeighbors const & neighbors) const;
+
+    /**
+     * @brief Works out the normal of every vertex from the heights around it
+     * 
+     * @param neighbors 
+     * @return std::array<PackedNormal, 17 * 17> the seams included
+     */
+    std::array<PackedNormal, 17 * 17> computeNormals(ChunkNeighbors const & neighbors) const;
+
+    /**
+     * @brief Gets the box around this chunk's mesh, seams included
+     * Chunk local, same as the vertices
+     */
+    AABB meshBounds(ChunkNeighbors const & neighbors) const;
+
+    void uploadDirtyVertices(ChunkNeighbors const & neighbors);
+};
+
+/**
+ * @brief What's kept of an edited chunk after it's evicted
+ * Only the tiles that differ from a freshly generated skeleton are stored, unless
+ * so much was changed that keeping all of them would be smaller
+ */
+struct ChunkDelta {
+    struct TileDelta {
+        Chunk::StoredHeight height;
+        uint8_t index;
+        Tile::Type type;
+    };
+
+    bool isSkeleton;
+    std::vector<TileDelta> tiles;
+    // either both empty, or every tile of the chunk with tiles empty instead
+    std::vector<Chunk::StoredHeight> heights;
+    std::vector<Tile::Type> types;
+
+    std::size_t memoryUsage() const;
 };
 
 struct World {
@@ -72,32 +371,102 @@ struct World {
     
     std::map<std::pair<int, int>, Chunk> chunks;
     std::set<std::pair<int, int>> outdatedChunks;
+    // chunks that were edited before being evicted. Unedited ones aren't kept at all,
+    // since they'll be regenerated exactly the same
+    std::map<std::pair<int, int>, ChunkDelta> evictedChunks;
+    // only exists if chunks are being saved. Evicted chunks are written here instead of evictedChunks
+    std::unique_ptr<RegionStore> regionStore;
+    // chunks that changed since they were last saved
+    std::set<std::pair<int, int>> unsavedChunks;
     int const worldSeed = 666666;
 
     std::optional<std::shared_ptr<Model>> model;
+    // what Decoration::model refers to
+    std::vector<std::weak_ptr<Model const>> decorationModels;
+
+    /**
+     * @brief Streams in chunks around a position and updates the world's model
+     * Only spends config.world.streamingBudget milliseconds doing so, whatever isn't done yet
+     * is continued next call. Chunks not generated yet are left out of the model
+     * 
+     * @param cx 
+     * @param cz 
+     * @param renderDistance 
+     * @param facing which way the camera is looking, chunks in front are streamed in first
+     * @return std::weak_ptr<Model> 
+     */
+    std::weak_ptr<Model> updateModel(int cx, int cz, int renderDistance, Vec3 facing = {0.f, 0.f, 0.f});
 
-    std::weak_ptr<Model> updateModel(int cx, int cz, int renderDistance);
+    /**
+     * @brief Queues every unsaved chunk to be written to the region store
+     * Skeletons that haven't been edited aren't saved, they'd just be regenerated the same anyways
+     */
+    void saveChunks();
 
     bool withinRenderDistance(ModelInstance const & mod) const;
 
     /**
-     * @brief Get a mutable pointer to a tile
+     * @brief Gets the id decorations use for a model, adding it if it's new
+     */
+    uint16_t decorationModelId(std::weak_ptr<Model const> const & model);
+
+    /**
+     * @brief Draws the decorations of every chunk in render distance
+     * One instanced draw per model per chunk
+     */
+    void drawDecorations() const;
+
+    /**
+     * @brief Edits every generated tile in a rectangle
+     * Each chunk is only looked up once, and gets one dirty rectangle for the whole edit
+     * (plus whatever of its neighbors' seams and normals it touched) instead of one per tile
      * 
-     * @param x 
-     * @param z 
-     * @return Tile*. Will be a nullptr if the tile has not been generated yet
+     * @param minX 
+     * @param minZ 
+     * @param maxX inclusive
+     * @param maxZ inclusive
+     * @param edit called as edit(x, z, tile) for every tile, x and z being world coordinates
      */
-    Tile* getTileMut(int x, int z);
+    template<typename F>
+    void editTiles(int const minX, int const minZ, int const maxX, int const maxZ, F const & edit) {
+        auto const [minCx, minTx] = floorDivMod(minX, 16);
+        auto const [minCz, minTz] = floorDivMod(minZ, 16);
+        auto const [maxCx, maxTx] = floorDivMod(maxX, 16);
+        auto const [maxCz, maxTz] = floorDivMod(maxZ, 16);
+
+        for(int cz = minCz; cz <= maxCz; cz++) for(int cx = minCx; cx <= maxCx; cx++) {
+            auto found = chunks.find({cx, cz});
+            if(found == chunks.end()) continue;
+            auto& chunk = found->second;
+            chunk.edited = true;
+
+            // the part of the rectangle inside of this chunk
+            int const x0 = cx == minCx? minTx : 0;
+            int const z0 = cz == minCz? minTz : 0;
+            int const x1 = cx == maxCx? maxTx : 15;
+            int const z1 = cz == maxCz? maxTz : 15;
+
+            for(int z = z0; z <= z1; z++) for(int x = x0; x <= x1; x++) {
+                auto tile = chunk.tile(z * 16 + x);
+                edit(cx * 16 + x, cz * 16 + z, tile);
+                chunk.setTile(z * 16 + x, tile);
+            }
+
+            this->unsavedChunks.insert({cx, cz});
+        }
+
+        this->markTilesDirty(minX, minZ, maxX, maxZ);
+    }
 
     /**
-     * @brief Get a pointer to a tile
-     * Like getTileMut, but const
+     * @brief Get a copy of a tile
+     * Use editTiles to change tiles, so the meshes get updated
      * 
      * @param x 
      * @param z 
-     * @return Tile const*. Will be a nullptr if the tile has not been generated yet
+     * @return std::optional<Tile>. Will be nullopt if the tile has not been generated yet
      */
-    Tile const * getTile(int x, int z) const;
+    std::optional<Tile> getTile(int x, int z) const;
 
     /**
      * @brief Get the height of the world at a given coordinate
@@ -109,6 +478,14 @@ struct World {
      */
     std::optional<float> sampleHeight(float x, float z);
 
+    /**
+     * @brief Get the normal of the terrain at a given coordinate
+     * Interpolated between the vertex normals, so it matches the lighting
+     * 
+     * @param x 
+     * @param z 
+     * @return std::optional<Vec3>. Will be nullopt if the tile has not been generated yet
+     */
     std::optional<Vec3> getWorldNormal(float x, float z);
 
 private:
@@ -116,10 +493,67 @@ private:
     int oldCz = -998;
     int oldRenderDistance = -1;
 
-    Model asModel(int cx, int cz, int renderDistance, int unloadDistance);
+    uint64_t chunkUseCounter = 0;
+    std::size_t evictedChunksMemoryUsage = 0;
+
+    // chunks in render distance that still need to be finished, the most important at the back
+    std::vector<std::pair<int, int>> streamingRequests;
+    // some chunks ran out of time to be meshed last update
+    bool meshingIncomplete = false;
+
+    Model asModel(
+        int cx, 
+        int cz, 
+        int renderDistance, 
+        int unloadDistance, 
+        std::chrono::steady_clock::time_point deadline
+    );
+
+    /**
+     * @brief Marks the vertices of every chunk affected by a rectangle of tiles changing
+     * 
+     * @param minX world coordinates, inclusive
+     * @param minZ 
+     * @param maxX 
+     * @param maxZ 
+     */
+    void markTilesDirty(int const minX, int const minZ, int const maxX, int const maxZ);
 
-    void loadChunks(int cx, int cz, int renderDistance);
+    /**
+     * @brief Replaces the streaming requests with every unfinished chunk in render distance
+     * Sorted by distance, with the chunks behind the camera counting as further away
+     */
+    void requestChunks(int cx, int cz, int renderDistance, Vec3 facing);
+    void streamChunks(std::chrono::steady_clock::time_point deadline);
     void unloadChunks(int cx, int cz, int unloadDistance);
+    void evictChunks(int cx, int cz, int keepDistance);
+
+    /**
+     * @brief Makes sure a chunk is in memory
+     * Restores it if it was evicted or saved, otherwise generates its skeleton
+     * 
+     * @param x 
+     * @param z 
+     * @return Chunk& 
+     */
+    Chunk& loadChunk(int x, int z);
+
+    /**
+     * @brief Gets whichever of the chunks around a chunk are loaded
+     * 
+     * @param cx 
+     * @param cz 
+     * @return ChunkNeighbors. nullptr for the ones that aren't
+     */
+    ChunkNeighbors neighborsOf(int cx, int cz) const;
+
+    /**
+     * @brief Rebuilds a finished chunk's decorations
+     * 
+     * @param chunk 
+     * @param sites from decorationSites
+     */
+    void populateChunk(Chunk& chunk, std::vector<DecorationJob> const & sites);
 };
 
 extern World world;
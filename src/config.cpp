@@ -18,9 +18,38 @@ resolutionY = 720
 msaa = 1
 vsync = true
 renderDistance = 3
+# Moves the render distance between min and maxRenderDistance to keep frames under
+# frameTimeBudget (in milliseconds), instead of always using renderDistance
+adaptiveRenderDistance = false
+minRenderDistance = 2
+maxRenderDistance = 8
+frameTimeBudget = 14
+# In chunks. Terrain is drawn at a lower detail every this many chunks away, 0 to always use full detail
+terrainLodDistance = 4
+# Displaces one shared grid on the GPU by a small heightmap per chunk instead of uploading
+# a mesh for each. Ignores terrainLodDistance. Falls back to meshes if the GPU can't do it
+heightmapTerrain = false
 fieldOfView = 60
 
 shadowMapResolution = 1536
+# Lets shadow casters tint the light going through them instead of only blocking it. Costs an
+# extra color target in the shadow pass
+tintedShadows = false
+
+# Draws the scene at a lower resolution while the GPU can't keep up, then scales it back up
+dynamicResolution = false
+# In milliseconds. How long the GPU can spend on a frame before the resolution starts dropping
+gpuFrameBudget = 14
+# The lowest fraction of the full resolution it can drop to
+minResolutionScale = 0.5
+
+[world]
+# In megabytes. Chunks that haven't been seen in a while are evicted once this is exceeded
+chunkMemoryBudget = 64
+# Keeps generated and edited chunks in ./world so they don't have to be regenerated next time
+saveChunks = true
+# In milliseconds. How long can be spent each frame generating and meshing chunks
+streamingBudget = 4
 
 # Possible control settings listed at https://wiki.libsdl.org/SDL_Keycode
 # "mouse1", "mouse2", etc. map to left click, right click, etc.
@@ -98,9 +127,28 @@ if(auto* keyName = settingsData[SETTING_SECTION][#ACTION_NAME].as_string()) {\
             GET_SETTING(msaa,           1   ),
             GET_SETTING(vsync,          true),
             GET_SETTING(renderDistance, 3   ),
+            GET_SETTING(adaptiveRenderDistance, false),
+            GET_SETTING(minRenderDistance, 2),
+            GET_SETTING(maxRenderDistance, 8),
+            GET_SETTING(frameTimeBudget, 14.0),
+            GET_SETTING(terrainLodDistance, 4),
+            GET_SETTING(heightmapTerrain, false),
             GET_SETTING(fieldOfView,    60.0),
 
             GET_SETTING(shadowMapResolution, 1526),
+            GET_SETTING(tintedShadows, false),
+
+            GET_SETTING(dynamicResolution, false),
+            GET_SETTING(gpuFrameBudget, 14.0),
+            GET_SETTING(minResolutionScale, 0.5),
+#undef SETTING_SECTION
+        },
+
+        .world {
+#define SETTING_SECTION "world"
+            GET_SETTING(chunkMemoryBudget, 64),
+            GET_SETTING(saveChunks, true),
+            GET_SETTING(streamingBudget, 4.0),
 #undef SETTING_SECTION
         },
 
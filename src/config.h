@@ -14,11 +14,28 @@ struct Config {
         int64_t msaa;
         bool vsync;
         int64_t renderDistance;
+        bool adaptiveRenderDistance;
+        int64_t minRenderDistance;
+        int64_t maxRenderDistance;
+        double frameTimeBudget;
+        int64_t terrainLodDistance;
+        bool heightmapTerrain;
         double fieldOfView;
 
         int64_t shadowMapResolution;
+        bool tintedShadows;
+
+        bool dynamicResolution;
+        double gpuFrameBudget;
+        double minResolutionScale;
     } graphics;
 
+    struct {
+        int64_t chunkMemoryBudget;
+        bool saveChunks;
+        double streamingBudget;
+    } world;
+
     struct {
         std::unordered_set<InputDatum> forward;
         std::unordered_set<InputDatum> back;
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cmath>
+
+#include "frameBudget.h"
+
+// how many frames to wait after a change before another
+static uint32_t const DROP_COOLDOWN = 8;
+static uint32_t const RAISE_COOLDOWN = 30;
+// it only goes back up once it'd still be comfortably under budget
+static float const RAISE_HEADROOM = 0.75f;
+static float const RAISE_STEP = 0.05f;
+
+FrameBudget::FrameBudget(float const budget, float const minScale)
+    : budget(budget)
+    , minScale(std::clamp(minScale, 0.1f, 1.f))
+{}
+
+void FrameBudget::update(float const gpuTime) {
+    this->averageTime = this->averageTime == 0.f?
+        gpuTime
+            :
+        this->averageTime * 0.8f + gpuTime * 0.2f;
+
+    if(this->cooldown > 0) {
+        this->cooldown--;
+        return;
+    }
+
+    // a spike goes right through, instead of waiting for the average to catch up
+    float const time = std::max(this->averageTime, gpuTime);
+    if(time > this->budget && this->currentScale > this->minScale) {
+        // time goes with the pixel count, which is the scale squared
+        this->currentScale = std::max(this->minScale, this->currentScale * std::sqrt(this->budget / time));
+        this->cooldown = DROP_COOLDOWN;
+        // the old times don't mean much at the new scale
+        this->averageTime = 0.f;
+    } else if(time < this->budget * RAISE_HEADROOM && this->currentScale < 1.f) {
+        this->currentScale = std::min(1.f, this->currentScale + RAISE_STEP);
+        this->cooldown = RAISE_COOLDOWN;
+        this->averageTime = 0.f;
+    }
+}
+
+float FrameBudget::scale() const {
+    return this->currentScale;
+}
+
+// in seconds
+static float const LOWER_AFTER = 0.5f;
+static float const RAISE_AFTER = 3.f;
+static float const DISTANCE_COOLDOWN = 2.f;
+// a step further out loads a whole ring of chunks, so there has to be a lot of room first
+static float const DISTANCE_RAISE_HEADROOM = 0.6f;
+
+RenderDistanceBudget::RenderDistanceBudget(float const budget, int const minDistance, int const maxDistance, int const startDistance)
+    : budget(budget)
+    , minDistance(std::max(minDistance, 1))
+    , maxDistance(std::max(maxDistance, this->minDistance))
+    , currentDistance(std::clamp(startDistance, this->minDistance, this->maxDistance))
+{}
+
+void RenderDistanceBudget::update(float const frameTime, float const cpuTime, float const gpuTime, bool const canRaise) {
+    float const time = std::max(cpuTime, gpuTime);
+    this->averageTime = this->averageTime == 0.f?
+        time
+            :
+        this->averageTime * 0.9f + time * 0.1f;
+
+    if(this->cooldown > 0.f) {
+        this->cooldown -= frameTime;
+        return;
+    }
+
+    this->overFor  = this->averageTime > this->budget? this->overFor + frameTime : 0.f;
+    this->underFor = this->averageTime < this->budget * DISTANCE_RAISE_HEADROOM && canRaise?
+        this->underFor + frameTime
+            :
+        0.f;
+
+    int const oldDistance = this->currentDistance;
+    if(this->overFor > LOWER_AFTER) {
+        this->currentDistance = std::max(this->minDistance, this->currentDistance - 1);
+    } else if(this->underFor > RAISE_AFTER) {
+        this->currentDistance = std::min(this->maxDistance, this->currentDistance + 1);
+    }
+
+    if(this->currentDistance != oldDistance) {
+        this->cooldown = DISTANCE_COOLDOWN;
+        this->overFor = 0.f;
+        this->underFor = 0.f;
+        this->averageTime = 0.f;
+    }
+}
+
+int RenderDistanceBudget::renderDistance() const {
+    return this->currentDistance;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Picks what fraction of the full resolution the scene is drawn at, to keep how
+ * long the GPU takes on a frame under a budget
+ * It drops as soon as frames go over, and creeps back up once there's room again, so a
+ * few heavy frames (explosions) don't leave it low for good
+ */
+struct FrameBudget {
+    FrameBudget() = default;
+    /**
+     * @param budget in seconds
+     * @param minScale the lowest it'll drop to
+     */
+    FrameBudget(float const budget, float const minScale);
+
+    /**
+     * @brief Takes in how long the GPU took on the last frame
+     * 
+     * @param gpuTime in seconds
+     */
+    void update(float const gpuTime);
+
+    /**
+     * @brief What fraction of the full resolution (on each axis) to draw at
+     * 
+     * @return float from minScale to 1
+     */
+    float scale() const;
+
+private:
+    float budget = 1.f;
+    float minScale = 1.f;
+    float currentScale = 1.f;
+
+    float averageTime = 0.f;
+    // the GPU times lag behind a few frames, so changes are given time to show up in them
+    // before anything else is changed
+    uint32_t cooldown = 0;
+};
+
+/**
+ * @brief Moves the render distance up and down to keep frames under a budget
+ * Frames have to be over or under for a while before it changes, and it waits a while
+ * after each change, since loading in more chunks makes for slow frames on its own
+ */
+struct RenderDistanceBudget {
+    RenderDistanceBudget() = default;
+    /**
+     * @param budget in seconds
+     * @param minDistance 
+     * @param maxDistance 
+     * @param startDistance 
+     */
+    RenderDistanceBudget(float const budget, int const minDistance, int const maxDistance, int const startDistance);
+
+    /**
+     * @brief Takes in how long the last frame took
+     * 
+     * @param frameTime in seconds, all of it including waiting on vsync
+     * @param cpuTime in seconds, what of frameTime the CPU was actually busy for
+     * @param gpuTime in seconds, 0 if it isn't known
+     * @param canRaise false if something else is already cutting back (the resolution
+     * is scaled down), so it doesn't undo that
+     */
+    void update(float const frameTime, float const cpuTime, float const gpuTime, bool const canRaise);
+
+    /**
+     * @brief In chunks
+     * 
+     * @return int from minDistance to maxDistance
+     */
+    int renderDistance() const;
+
+private:
+    float budget = 1.f;
+    int minDistance = 0;
+    int maxDistance = 0;
+    int currentDistance = 0;
+
+    float averageTime = 0.f;
+    // in seconds, how long it's been over or well under the budget
+    float overFor = 0.f;
+    float underFor = 0.f;
+    float cooldown = 0.f;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <bx/math.h> // NOLINT(modernize-deprecated-headers)
+
+#include "mathUtils.h"
+
+/**
+ * @brief Where the camera and light are for a frame
+ * The simulation fills one in while the last one is still being submitted, see
+ * RendererState::submitFrame. Nothing changes it after it's been handed off
+ */
+struct FrameState {
+    Mat4 lightViewMtx = IDENTITY_MTX;
+    Mat4 lightProjectionMtx = IDENTITY_MTX;
+    Mat4 lightMapMtx = IDENTITY_MTX;
+    Mat4 cameraViewMtx = IDENTITY_MTX;
+    Mat4 cameraProjectionMtx = IDENTITY_MTX;
+    Mat4 cameraMtx = IDENTITY_MTX;
+    bx::Vec3 cameraPos = {0.f, 0.f, 0.f};
+
+    // how much of the full resolution the scene is drawn at, on each axis
+    float resolutionScale = 1.f;
+
+    // for culling anything the scene/shadow views can't see
+    Frustum cameraFrustum{};
+    Frustum lightFrustum{};
+};
@@ -42,37 +42,39 @@ void InputState::updateInputs() {
     }
 }
 
-bx::Vec3 getScreenWorldPos(float x, float y) {
-    static float depth;
-    static bgfx::TextureHandle depthTexture = BGFX_INVALID_HANDLE;
-    if(!bgfx::isValid(depthTexture)) [[unlikely]] {
-        auto format = bgfx::isTextureValid(0, false, 1, bgfx::TextureFormat::D32F, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK)?
-            bgfx::TextureFormat::D32F : bgfx::TextureFormat::D24;
-        depthTexture = bgfx::createTexture2D(1, 1, false, 1, format, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK);
-    }
+void requestScreenWorldPos(float const x, float const y, EntityId const id, void (*callback)(EntityId const, bx::Vec3 const)) {
+    // the camera will have moved by the time the depth gets back, so it's undone with the
+    // one it was drawn with
+    auto const & frame = rendererState.lastFrameState();
 
-    auto px = (int64_t)((x    ) * config.graphics.resolutionX);
-    auto py = (int64_t)((1 - y) * config.graphics.resolutionY);
+    // the scene only covers part of screenDepth when it's been scaled down
+    int64_t const width  = config.graphics.resolutionX * frame.resolutionScale;
+    int64_t const height = config.graphics.resolutionY * frame.resolutionScale;
+    // rows count up from the bottom, and the scene's drawn at the top
+    auto px = (int64_t)(x * width);
+    auto py = (int64_t)(config.graphics.resolutionY - y * height);
 
     // mingw gets pissed if the <int64_t> isn't here
-    px = std::clamp<int64_t>(px, 0l, config.graphics.resolutionX - 1);
-    py = std::clamp<int64_t>(py, 0l, config.graphics.resolutionY - 1);
-
-    bgfx::setViewClear(RENDER_BLIT_MOUSE_ID, BGFX_CLEAR_DEPTH);
-    bgfx::blit(RENDER_BLIT_MOUSE_ID, depthTexture, 0, 0, rendererState.screenDepth, px, py, 1, 1);
-    bgfx::readTexture(depthTexture, &depth);
+    px = std::clamp<int64_t>(px, 0l, width - 1);
+    py = std::clamp<int64_t>(py, config.graphics.resolutionY - height, config.graphics.resolutionY - 1);
 
     Mat4 viewInv;
-    bx::mtxInverse(viewInv.data(), rendererState.cameraViewMtx.data());
+    bx::mtxInverse(viewInv.data(), frame.cameraViewMtx.data());
 
     Mat4 projInv;
-    bx::mtxInverse(projInv.data(), rendererState.cameraProjectionMtx.data());
+    bx::mtxInverse(projInv.data(), frame.cameraProjectionMtx.data());
+
+    // RENDER_READBACK_ID goes after the scene in the view order, so this copies the depth
+    // that frame was drawn with
+    rendererState.depthReadback.request(RENDER_READBACK_ID, rendererState.screenDepth, px, py, [=](float const depth) {
+        if(!entitySystem.entities.contains(id)) return;
 
-    auto xy = projInv * Vec3{x * 2 - 1, -y * 2 + 1, 0};
-    // holy shit it took me like at least 10 hours to figure out this is the equasion I need
-    // yet I still have no idea how it works
-    // touch with peril
-    auto z = 0.5f * (FAR_CLIP + NEAR_CLIP) * (2 * NEAR_CLIP) / (FAR_CLIP - depth * (FAR_CLIP - NEAR_CLIP));
-    
-    return viewInv * Vec3{xy.x * z, xy.y * z, z};
+        auto xy = projInv * Vec3{x * 2 - 1, -y * 2 + 1, 0};
+        // holy shit it took me like at least 10 hours to figure out this is the equasion I need
+        // yet I still have no idea how it works
+        // touch with peril
+        auto z = 0.5f * (FAR_CLIP + NEAR_CLIP) * (2 * NEAR_CLIP) / (FAR_CLIP - depth * (FAR_CLIP - NEAR_CLIP));
+        
+        callback(id, viewInv * Vec3{xy.x * z, xy.y * z, z});
+    });
 }
@@ -26,4 +26,14 @@ struct InputComponent {
     void (*onInput)(InputState const &, EntityId const);
 };
 
-bx::Vec3 getScreenWorldPos(float x, float y);
+/**
+ * @brief Finds where in the world a point on the screen is
+ * The depth there has to be read back from the GPU, so the answer comes a couple frames
+ * later. If there's too many reads going already it never comes
+ * 
+ * @param x from 0 to 1, left to right
+ * @param y from 0 to 1, top to bottom
+ * @param id passed to callback. If the entity's gone by then, callback isn't called
+ * @param callback 
+ */
+void requestScreenWorldPos(float const x, float const y, EntityId const id, void (*callback)(EntityId const, bx::Vec3 const));
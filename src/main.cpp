@@ -1,4 +1,5 @@
 #include <vector>
+#include <unordered_map>
 #include <chrono>
 #include <thread>
 #include <bgfx/bgfx.h>
@@ -66,32 +67,66 @@ int main() {
             comp.step(id, rendererState.lastFrameTimeElapsed);
         }
 
+        // the last frame was being submitted while all of that ran, so now it can go.
+        // Past here everything's drawn as part of this frame
+        rendererState.finishRender();
+        playerUpdateWorld();
+
         bgfx::setUniform(
             rendererState.uniforms.u_frame, 
             std::vector<float>{rendererState.frame / 1000.f, 0.0, 0.0, 0.0}.data()
         );
 
-        bgfx::setViewClear(RENDER_SHADOW_ID, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0xffffffff);
+        bgfx::setViewClear(RENDER_STATIC_SHADOW_ID, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0xffffffff);
+        // the static shadows get copied over it instead
+        bgfx::setViewClear(RENDER_SHADOW_ID, rendererState.cacheStaticShadows? BGFX_CLEAR_NONE : BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0xffffffff);
         bgfx::setViewClear(RENDER_SCENE_ID,  BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x8899ffff);
         bgfx::setViewClear(RENDER_SCREEN_ID, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x8899ffff);
 
         {
+            // every view in use has to be listed, bgfx doesn't put the ones left out anywhere
+            // in particular
             std::vector<bgfx::ViewId> viewOrder = {
+                RENDER_STATIC_SHADOW_ID,
                 RENDER_SHADOW_ID,
                 RENDER_SCENE_ID,
+                RENDER_READBACK_ID,
                 RENDER_SCREEN_ID,
             };
 
             bgfx::setViewOrder(0, viewOrder.size(), viewOrder.data());
         }
        
-        for(auto const & [_, model]: entitySystem.filterByComponent<ModelInstance>()) {
-            if(model.mustRender || world.withinRenderDistance(model)) model.draw();
+        {
+            // everything with the same model gets drawn in one go
+            std::unordered_map<Model const *, std::vector<ModelInstance const *>> batches;
+            for(auto const & [_, model]: entitySystem.filterByComponent<ModelInstance>()) {
+                if(model.mustRender || world.withinRenderDistance(model)) {
+                    batches[model.model.lock().get()].push_back(&model);
+                }
+            }
+
+            std::vector<Mat4> orientations;
+            for(auto const & [_, instances]: batches) {
+                if(instances.size() == 1) {
+                    instances.front()->draw();
+                    continue;
+                }
+
+                orientations.clear();
+                for(auto const instance: instances) orientations.push_back(instance->orientation);
+                drawModelInstanced(instances.front()->model, orientations);
+            }
         }
+        world.drawDecorations();
 
-        rendererState.finishRender();
+        rendererState.submitFrame();
         entitySystem.removeQueuedEntities();
     }
+    rendererState.finishRender();
+
+    world.saveChunks();
+    world.regionStore.reset();
 
     terminateGui();
 
@@ -8,6 +8,73 @@ std::tuple<int, float> floorFract(float const x) {
     else return {(int) floor - 1, fract + 1};
 }
 
+AABB AABB::transformed(Mat4 const & mtx) const {
+    auto const center = (this->min + this->max) / 2.f;
+    auto const extent = (this->max - this->min) / 2.f;
+
+    // each axis of the new box gets however much of the old extents the matrix rotates onto it
+    Vec3 const newExtent{
+        std::abs(mtx[0]) * extent.x + std::abs(mtx[4]) * extent.y + std::abs(mtx[8 ]) * extent.z,
+        std::abs(mtx[1]) * extent.x + std::abs(mtx[5]) * extent.y + std::abs(mtx[9 ]) * extent.z,
+        std::abs(mtx[2]) * extent.x + std::abs(mtx[6]) * extent.y + std::abs(mtx[10]) * extent.z,
+    };
+    auto const newCenter = mtx * center;
+
+    return {
+        .min = newCenter - newExtent,
+        .max = newCenter + newExtent,
+    };
+}
+
+AABB AABB::merged(AABB const & other) const {
+    return {
+        .min = {std::min(this->min.x, other.min.x), std::min(this->min.y, other.min.y), std::min(this->min.z, other.min.z)},
+        .max = {std::max(this->max.x, other.max.x), std::max(this->max.y, other.max.y), std::max(this->max.z, other.max.z)},
+    };
+}
+
+Frustum Frustum::fromMatrix(Mat4 const & viewProjection, bool const homogeneousDepth) {
+    // bx matrices multiply row vectors, so the rows of the usual
+    // column vector matrix are the columns here
+    auto const row = [&](int const r) {
+        return std::array<float, 4>{viewProjection[r], viewProjection[4 + r], viewProjection[8 + r], viewProjection[12 + r]};
+    };
+    auto const add = [](std::array<float, 4> const a, std::array<float, 4> const b, float const sign) {
+        return std::array<float, 4>{a[0] + sign * b[0], a[1] + sign * b[1], a[2] + sign * b[2], a[3] + sign * b[3]};
+    };
+
+    auto const x = row(0);
+    auto const y = row(1);
+    auto const z = row(2);
+    auto const w = row(3);
+
+    return Frustum{
+        .planes = {
+            add(w, x,  1.f), // left
+            add(w, x, -1.f), // right
+            add(w, y,  1.f), // bottom
+            add(w, y, -1.f), // top
+            homogeneousDepth? add(w, z, 1.f) : z, // near, depth goes -1 to 1 in OpenGL and 0 to 1 otherwise
+            add(w, z, -1.f), // far
+        },
+    };
+}
+
+bool Frustum::intersects(AABB const & box) const {
+    for(auto const & [a, b, c, d]: this->planes) {
+        // the corner furthest along the plane's normal
+        auto const furthest = 
+            a * (a > 0? box.max.x : box.min.x)
+          + b * (b > 0? box.max.y : box.min.y)
+          + c * (c > 0? box.max.z : box.min.z)
+          + d;
+
+        if(furthest < 0) return false;
+    }
+
+    return true;
+}
+
 float interpolate(
     float const s00, 
     float const s01, 
@@ -11,6 +11,13 @@
 
 using Mat4 = std::array<float, 16>;
 
+constexpr Mat4 IDENTITY_MTX = {
+    1.f, 0.f, 0.f, 0.f,
+    0.f, 1.f, 0.f, 0.f,
+    0.f, 0.f, 1.f, 0.f,
+    0.f, 0.f, 0.f, 1.f,
+};
+
 struct Vec3 {
     float x;
     float y;
@@ -88,16 +95,57 @@ inline Mat4 operator *(Mat4 const & mtxA, Mat4 const & mtxB) {
     return ret;
 }
 
+struct AABB {
+    Vec3 min;
+    Vec3 max;
+
+    /**
+     * @brief Gets the box around this one after it's been transformed
+     * 
+     * @param mtx 
+     * @return AABB 
+     */
+    AABB transformed(Mat4 const & mtx) const;
+
+    // the box around both of them
+    AABB merged(AABB const & other) const;
+};
+
+/**
+ * @brief The planes around everything a view projection matrix can see
+ */
+struct Frustum {
+    // a, b, c, d where ax + by + cz + d >= 0 is the inside
+    std::array<std::array<float, 4>, 6> planes;
+
+    static Frustum fromMatrix(Mat4 const & viewProjection, bool const homogeneousDepth);
+
+    /**
+     * @brief Checks if any part of a box could be seen
+     * Boxes near the corners can get false positives, never false negatives
+     * 
+     * @param box 
+     * @return bool 
+     */
+    bool intersects(AABB const & box) const;
+};
+
 template<typename T>
 struct RGB {
     T r;
     T g;
     T b;
 
-    void appendToVector(std::vector<T>& vec) {
-        vec.push_back(r);
-        vec.push_back(g);
-        vec.push_back(b);
+    // packs into the byte order bgfx expects for a normalized 4 x Uint8 attribute
+    uint32_t asABGR8(float const a = 1.f) const {
+        auto const toByte = [](float const c) {
+            return (uint32_t)(std::clamp((float)c, 0.f, 1.f) * 255.f + 0.5f);
+        };
+
+        return toByte(r)
+            | (toByte(g) << 8)
+            | (toByte(b) << 16)
+            | (toByte(a) << 24);
     }
 };
     
@@ -109,6 +157,19 @@ struct RGB {
  */
 std::tuple<int, float> floorFract(float const x);
 
+/**
+ * @brief Divides towards -inf, so the remainder is never negative
+ * 
+ * @param x 
+ * @param divisor 
+ * @return std::tuple<int, int> A tuple of the quotient and remainder
+ */
+inline std::tuple<int, int> floorDivMod(int const x, int const divisor) {
+    auto const div = std::div(x, divisor);
+    if(div.rem < 0) return {div.quot - 1, div.rem + divisor};
+    else return {div.quot, div.rem};
+}
+
 /**
  * @brief Interpolates between the corners of a square.
  * 
@@ -181,6 +242,30 @@ inline float randFromCoord(int x, int y, std::size_t seed) {
     ) / (double) std::numeric_limits<std::size_t>::max();
 }
 
+/**
+ * @brief A cheap integer hash of a coordinate, for when a lot of them are needed at once
+ * 
+ * @param x 
+ * @param y 
+ * @param seed 
+ * @return uint32_t 
+ */
+constexpr uint32_t hashCoord(int const x, int const y, uint32_t const seed) {
+    uint32_t h = seed ^ 0x9e3779b9u;
+    h ^= (uint32_t)x * 0xcc9e2d51u;
+    h = ((h << 13) | (h >> 19)) * 5u + 0xe6546b64u;
+    h ^= (uint32_t)y * 0x1b873593u;
+    h = ((h << 13) | (h >> 19)) * 5u + 0xe6546b64u;
+
+    // murmur3's finalizer
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
 /**
  * @brief Generates a square of noise
  * 
@@ -257,10 +257,20 @@ Model Model::loadFromGLTFModel(
             BGFX_BUFFER_INDEX32
         );
 
+        std::optional<AABB> bounds = std::nullopt;
+        for(std::size_t i = 0; i + 2 < positions.size(); i += 3) {
+            Vec3 const position{positions[i], positions[i + 1], positions[i + 2]};
+            if(!bounds.has_value()) bounds = AABB{position, position};
+
+            bounds->min = {std::min(bounds->min.x, position.x), std::min(bounds->min.y, position.y), std::min(bounds->min.z, position.z)};
+            bounds->max = {std::max(bounds->max.x, position.x), std::max(bounds->max.y, position.y), std::max(bounds->max.z, position.z)};
+        }
+
         retPrimitives.push_back({
             .vertexBuffer = retVertexBuffer,
             .indexBuffer = retIndexBuffer,
             .layout = retLayout,
+            .bounds = bounds,
         });
     }
 
@@ -330,6 +340,7 @@ std::weak_ptr<Model const> ModelLoader::getModel(
 }
 
 void Model::Primitive::destroy() {
-    bgfx::destroy(this->vertexBuffer);
+    std::visit([](auto const handle){ bgfx::destroy(handle); }, this->vertexBuffer);
     bgfx::destroy(this->indexBuffer);
+    if(this->heightmap.has_value()) bgfx::destroy(this->heightmap.value());
 }
@@ -4,9 +4,13 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <optional>
+#include <variant>
 #include <bgfx/bgfx.h>
 #include <tiny_gltf.h>
 
+#include "mathUtils.h"
+
 struct Model {
     static Model loadFromGLBData(
         tinygltf::TinyGLTF& loader, 
@@ -24,9 +28,17 @@ struct Model {
     );
 
     struct Primitive {
-        bgfx::VertexBufferHandle const vertexBuffer;
+        // dynamic for primitives that get patched in place (i.e. terrain chunks)
+        std::variant<bgfx::VertexBufferHandle, bgfx::DynamicVertexBufferHandle> const vertexBuffer;
         bgfx::IndexBufferHandle  const indexBuffer;
         bgfx::VertexLayout const layout;
+        // Applied before the instance's orientation, lets primitives that share
+        // a ModelInstance (i.e. terrain chunks) keep their vertices local
+        Mat4 transform = IDENTITY_MTX;
+        // in the primitive's own space, before the transform. Never culled if there isn't one
+        std::optional<AABB> bounds = std::nullopt;
+        // heights and tile types for the terrain programs to displace the vertices by
+        std::optional<bgfx::TextureHandle> heightmap = std::nullopt;
 
         void destroy();
     };
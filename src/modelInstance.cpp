@@ -1,7 +1,35 @@
 #include <bx/math.h> // NOLINT(modernize-deprecated-headers)
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #include "modelInstance.h"
 #include "rendererState.h"
+#include "config.h"
+
+static uint64_t shadowState() {
+    static uint64_t const state = 
+        BGFX_STATE_WRITE_Z
+      | BGFX_STATE_DEPTH_TEST_LESS
+      | BGFX_STATE_CULL_CCW
+      | (config.graphics.tintedShadows?
+            BGFX_STATE_WRITE_RGB
+          | BGFX_STATE_WRITE_A
+          | BGFX_STATE_BLEND_FUNC(BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_ONE)
+          | BGFX_STATE_BLEND_EQUATION(BGFX_STATE_BLEND_EQUATION_MIN)
+            :
+          0);
+
+    return state;
+}
+
+static uint64_t const SCENE_STATE =
+    BGFX_STATE_WRITE_RGB
+  | BGFX_STATE_WRITE_A
+  | BGFX_STATE_WRITE_Z
+  | BGFX_STATE_CULL_CCW
+  | BGFX_STATE_DEPTH_TEST_LESS
+  | BGFX_STATE_MSAA;
 
 ModelInstance ModelInstance::fromModelPtr(std::weak_ptr<Model const> const & nModel) {
     Mat4 nOrientation;
@@ -13,42 +41,126 @@ ModelInstance ModelInstance::fromModelPtr(std::weak_ptr<Model const> const & nMo
     };
 }
 
+/**
+ * @brief How far something is from the camera, for sorting
+ */
+static float cameraDistance(std::optional<AABB> const & worldBounds, Mat4 const & mtx) {
+    Vec3 const center = worldBounds.has_value()?
+        (worldBounds->min + worldBounds->max) / 2.f
+            :
+        Vec3{mtx[12], mtx[13], mtx[14]};
+    return (center - Vec3(rendererState.frameState().cameraPos)).length();
+}
+
 void ModelInstance::draw() const {
     for(auto const & prim: model.lock()->primitives) {       
-        bgfx::setUniform(rendererState.uniforms.u_modelMtx, orientation.data());
-        bgfx::setState(
-            BGFX_STATE_WRITE_RGB
-          | BGFX_STATE_WRITE_A
-          | BGFX_STATE_CULL_CCW
-          | BGFX_STATE_BLEND_FUNC(BGFX_STATE_BLEND_ONE, BGFX_STATE_BLEND_ONE)
-          | BGFX_STATE_BLEND_EQUATION(BGFX_STATE_BLEND_EQUATION_MIN)
+        auto const mtx = orientation * prim.transform;
+
+        auto const worldBounds = prim.bounds.has_value()?
+            std::make_optional(prim.bounds->transformed(mtx))
+                :
+            std::nullopt;
+        bool const inShadowView = !worldBounds.has_value() || rendererState.frameState().lightFrustum.intersects(worldBounds.value());
+        bool const inSceneView  = !worldBounds.has_value() || rendererState.frameState().cameraFrustum.intersects(worldBounds.value());
+        auto const distance = cameraDistance(worldBounds, mtx);
+        auto const shadowView = this->staticShadow? rendererState.staticShadowView() : RENDER_SHADOW_ID;
+
+        if(inShadowView && shadowView.has_value()) rendererState.renderQueue().push(
+            shadowView.value(),
+            prim.heightmap.has_value()? rendererState.terrainShadowProgram : rendererState.shadowProgram,
+            shadowState(),
+            prim,
+            mtx,
+            distance
         );
 
-        bgfx::setTransform(orientation.data());
+        if(inSceneView) rendererState.renderQueue().push(
+            RENDER_SCENE_ID,
+            prim.heightmap.has_value()? rendererState.terrainProgram : rendererState.sceneProgram,
+            SCENE_STATE,
+            prim,
+            mtx,
+            distance
+        );
+    }
+}
 
-        bgfx::setVertexBuffer(0, prim.vertexBuffer);
-        bgfx::setIndexBuffer(prim.indexBuffer);
+/**
+ * @brief Queues one primitive at every one of the transforms as a single draw
+ */
+static void pushInstanced(
+    bgfx::ViewId const view,
+    Model::Primitive const & prim,
+    std::vector<Mat4> const & transforms,
+    float const distance,
+    bgfx::ProgramHandle const program,
+    uint64_t const state
+) {
+    if(transforms.empty()) return;
 
-        bgfx::submit(RENDER_SHADOW_ID, rendererState.shadowProgram);
+    uint16_t const stride = sizeof(Mat4);
+    // anything past what's left this frame just doesn't get drawn
+    uint32_t const count = std::min<uint32_t>(transforms.size(), bgfx::getAvailInstanceDataBuffer(transforms.size(), stride));
+    if(count == 0) return;
 
-        bgfx::setUniform(rendererState.uniforms.u_modelMtx, orientation.data());
-        bgfx::setUniform(rendererState.uniforms.u_lightMapMtx, rendererState.lightMapMtx.data());
-        bgfx::setState(
-            BGFX_STATE_WRITE_RGB
-          | BGFX_STATE_WRITE_A
-          | BGFX_STATE_WRITE_Z
-          | BGFX_STATE_CULL_CCW
-          | BGFX_STATE_DEPTH_TEST_LESS
-          | BGFX_STATE_MSAA
-        );
+    bgfx::InstanceDataBuffer instances;
+    bgfx::allocInstanceDataBuffer(&instances, count, stride);
+    std::memcpy(instances.data, transforms.data(), count * stride);
 
-        bgfx::setTransform(orientation.data());
+    rendererState.renderQueue().pushInstanced(view, program, state, prim, instances, distance);
+}
 
-        bgfx::setVertexBuffer(0, prim.vertexBuffer);
-        bgfx::setIndexBuffer(prim.indexBuffer);
+void drawModelInstanced(
+    std::weak_ptr<Model const> const & model, 
+    std::vector<Mat4> const & orientations, 
+    bool const staticShadow
+) {
+    if(orientations.empty()) return;
 
-        bgfx::submit(RENDER_SCENE_ID, rendererState.sceneProgram);
+    if(!(bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING)) {
+        for(auto const & orientation: orientations) {
+            ModelInstance{.model = model, .orientation = orientation, .staticShadow = staticShadow}.draw();
+        }
+        return;
     }
 
-    bgfx::setTexture(0, rendererState.uniforms.u_shadowMap, rendererState.shadowMap);
+    auto const shadowView = staticShadow? rendererState.staticShadowView() : RENDER_SHADOW_ID;
+    auto const & frame = rendererState.frameState();
+
+    auto const lockedModel = model.lock();
+    if(!lockedModel) return;
+
+    std::vector<Mat4> inShadowView;
+    std::vector<Mat4> inSceneView;
+    inShadowView.reserve(orientations.size());
+    inSceneView.reserve(orientations.size());
+
+    for(auto const & prim: lockedModel->primitives) {
+        inShadowView.clear();
+        inSceneView.clear();
+        float nearest = INFINITY;
+
+        for(auto const & orientation: orientations) {
+            auto const mtx = orientation * prim.transform;
+
+            if(!prim.bounds.has_value()) {
+                inShadowView.push_back(mtx);
+                inSceneView.push_back(mtx);
+                nearest = std::min(nearest, cameraDistance(std::nullopt, mtx));
+                continue;
+            }
+
+            auto const worldBounds = prim.bounds->transformed(mtx);
+            if(frame.lightFrustum.intersects(worldBounds))  inShadowView.push_back(mtx);
+            if(frame.cameraFrustum.intersects(worldBounds)) {
+                inSceneView.push_back(mtx);
+                nearest = std::min(nearest, cameraDistance(worldBounds, mtx));
+            }
+        }
+
+        if(shadowView.has_value()) {
+            pushInstanced(shadowView.value(), prim, inShadowView, nearest, rendererState.shadowInstancedProgram, shadowState());
+        }
+        pushInstanced(RENDER_SCENE_ID,  prim, inSceneView,  nearest, rendererState.sceneInstancedProgram,  SCENE_STATE);
+    }
 }
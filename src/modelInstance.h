@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "model.h"
 #include "mathUtils.h"
@@ -11,6 +12,23 @@ struct ModelInstance {
     std::weak_ptr<Model const> model;
     Mat4 orientation;
     bool mustRender = false;
+    // never moves, so its shadow can be cached (see RendererState::staticShadowMap)
+    bool staticShadow = false;
 
     void draw() const;
 };
+
+/**
+ * @brief Draws a model at a bunch of places, with one draw call per primitive per view
+ * Each instance is still culled on its own. Doesn't do heightmaps, those are only
+ * ever on the world's model anyways
+ * 
+ * @param model 
+ * @param orientations 
+ * @param staticShadow same as ModelInstance::staticShadow
+ */
+void drawModelInstanced(
+    std::weak_ptr<Model const> const & model, 
+    std::vector<Mat4> const & orientations, 
+    bool const staticShadow = false
+);
@@ -104,15 +104,20 @@ void shootAt(Vec3 const & at) {
 
                 auto h = world.sampleHeight(pos.x, pos.z);
                 if(h && h.value() - pos.y < 2.f) {
-                    Tile* damagedTile = world.getTileMut(pos.x + 0.5, pos.z + 0.5);
-                    damagedTile->height -= 0.3;
-                    damagedTile->type = Tile::Type::Blasted;
+                    int const x = pos.x + 0.5;
+                    int const z = pos.z + 0.5;
+                    world.editTiles(x, z, x, z, [](int const _x, int const _z, Tile& damagedTile) {
+                        damagedTile.height -= 0.3;
+                        damagedTile.type = Tile::Type::Blasted;
+                    });
                 }
             }
         });
     }
 }
 
+static Vec3 const cameraOffset = Vec3{5.f, 7.f, 5.f};
+
 void playerOnInput(InputState const & inputs, EntityId const id) {
     auto& obj = entitySystem.getComponentData<PhysicsComponent>(id);
 
@@ -138,7 +143,9 @@ void playerOnInput(InputState const & inputs, EntityId const id) {
 
     for(auto inp: inputs.inputsJustPressed) {
         if(config.keybindings.attack.contains(inp)) {
-            shootAt(getScreenWorldPos(inputs.mousePosXNormal, inputs.mousePosYNormal));
+            requestScreenWorldPos(inputs.mousePosXNormal, inputs.mousePosYNormal, id, [](EntityId const _id, bx::Vec3 const at) {
+                shootAt(at);
+            });
         }
     }
 
@@ -146,7 +153,7 @@ void playerOnInput(InputState const & inputs, EntityId const id) {
     int chunkZ = ((int)obj.position.z) / 16;
 
     rendererState.setCameraOrientation(
-        obj.position + Vec3{5.f, 7.f, 5.f},
+        obj.position + cameraOffset,
         obj.position
     );
     rendererState.setLightOrientation(
@@ -155,7 +162,15 @@ void playerOnInput(InputState const & inputs, EntityId const id) {
         50,
         80
     );
-    world.updateModel(chunkX, chunkZ, config.graphics.renderDistance);
+}
+
+void playerUpdateWorld() {
+    auto const & obj = entitySystem.getComponentData<PhysicsComponent>(playerId);
+
+    int chunkX = ((int)obj.position.x) / 16;
+    int chunkZ = ((int)obj.position.z) / 16;
+
+    world.updateModel(chunkX, chunkZ, rendererState.renderDistanceBudget.renderDistance(), -cameraOffset);
 }
 
 char const * const DRAG_DROP_INVENTORY_INDEX = "Inventory Index";
@@ -2,4 +2,11 @@
 
 #include "entitySystem.h"
 
-EntityId createPlayer();
\ No newline at end of file
+EntityId createPlayer();
+
+/**
+ * @brief Streams and meshes the chunks around the player
+ * Uploads to the GPU, so has to be called after the last frame was finished, not while
+ * it's still being submitted
+ */
+void playerUpdateWorld();
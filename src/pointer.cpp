@@ -14,9 +14,11 @@
 std::optional<HealthComponent> pointeeHealth;
 
 void pointerOnInput(InputState const & inputs, EntityId const id) {
-    auto& pointerPhysics = entitySystem.getComponentData<PhysicsComponent>(id);
-    pointerPhysics.position = getScreenWorldPos(inputs.mousePosXNormal, inputs.mousePosYNormal);
+    requestScreenWorldPos(inputs.mousePosXNormal, inputs.mousePosYNormal, id, [](EntityId const id, bx::Vec3 const position) {
+        entitySystem.getComponentData<PhysicsComponent>(id).position = position;
+    });
 
+    auto const & pointerPhysics = entitySystem.getComponentData<PhysicsComponent>(id);
     for(auto inp: inputs.inputsJustPressed) if(config.keybindings.place.contains(inp)) {
         createEnemy(pointerPhysics.position);
     }
@@ -0,0 +1,51 @@
+#include <cstring>
+
+#include "readback.h"
+
+ReadbackRing::ReadbackRing(bgfx::TextureFormat::Enum const format)
+    : format(format)
+{
+    for(auto& slot: this->slots) {
+        slot.texture = bgfx::createTexture2D(1, 1, false, 1, format, BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK);
+    }
+}
+
+bool ReadbackRing::request(
+    bgfx::ViewId const view,
+    bgfx::TextureHandle const source,
+    uint16_t const x,
+    uint16_t const y,
+    std::function<void(float const)> callback
+) {
+    auto& slot = this->slots[this->next];
+    // they're used in order, so if this one's busy the rest are too
+    if(slot.readyFrame.has_value()) return false;
+    this->next = (this->next + 1) % this->slots.size();
+
+    bgfx::blit(view, slot.texture, 0, 0, source, x, y, 1, 1);
+    slot.readyFrame = bgfx::readTexture(slot.texture, slot.data.data());
+    slot.callback = std::move(callback);
+
+    return true;
+}
+
+void ReadbackRing::update(uint32_t const frame) {
+    for(auto& slot: this->slots) {
+        if(!slot.readyFrame.has_value() || slot.readyFrame.value() > frame) continue;
+
+        float value;
+        if(this->format == bgfx::TextureFormat::D32F || this->format == bgfx::TextureFormat::R32F) {
+            std::memcpy(&value, slot.data.data(), sizeof(value));
+        } else {
+            // 24 bit depth comes back as a normalized 32 bit int
+            uint32_t raw;
+            std::memcpy(&raw, slot.data.data(), sizeof(raw));
+            value = raw / (float)UINT32_MAX;
+        }
+
+        // freed first, in case the callback wants to read something else
+        slot.readyFrame = std::nullopt;
+        auto const callback = std::move(slot.callback);
+        callback(value);
+    }
+}
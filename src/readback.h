@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <optional>
+#include <bgfx/bgfx.h>
+
+/**
+ * @brief Reads single texels back off the GPU without waiting on them
+ * Every read gets the next staging texture in a ring. bgfx says which frame the texel will
+ * be there by, and the callback is called once that frame comes around. If every staging
+ * texture is still waiting on a read, the new one is dropped instead of stalling
+ */
+struct ReadbackRing {
+    static std::size_t const SIZE = 8;
+
+    ReadbackRing() = default;
+    /**
+     * @param format of the textures that will be read from. D32F, R32F, D24 or D24S8
+     */
+    ReadbackRing(bgfx::TextureFormat::Enum const format);
+
+    /**
+     * @brief Copies a texel out of a texture, to be read once it gets off the GPU
+     * Has to be called from the thread that called bgfx::init
+     * 
+     * @param view the copy is done in. Has to come after anything that draws to source
+     * @param source 
+     * @param x 
+     * @param y 
+     * @param callback given the texel's first channel, from 0 to 1 for depth
+     * @return bool false if there wasn't a staging texture free, and the callback won't be called
+     */
+    bool request(
+        bgfx::ViewId const view,
+        bgfx::TextureHandle const source,
+        uint16_t const x,
+        uint16_t const y,
+        std::function<void(float const)> callback
+    );
+
+    /**
+     * @brief Calls the callback of every read that's gotten off the GPU
+     * 
+     * @param frame what bgfx::frame last returned
+     */
+    void update(uint32_t const frame);
+
+private:
+    struct Slot {
+        bgfx::TextureHandle texture = BGFX_INVALID_HANDLE;
+        // bgfx's render thread writes the texel straight in here
+        std::array<uint8_t, 4> data{};
+        // nullopt if it's free
+        std::optional<uint32_t> readyFrame;
+        std::function<void(float const)> callback;
+    };
+
+    bgfx::TextureFormat::Enum format = bgfx::TextureFormat::D32F;
+    std::array<Slot, SIZE> slots;
+    std::size_t next = 0;
+};
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "regionStore.h"
+#include "chunk.h"
+#include "mathUtils.h"
+
+static char const REGION_MAGIC[4] = {'S', 'P', 'R', 'G'};
+static uint32_t const REGION_VERSION = 4;
+
+// magic, version, seed, then the table
+static std::size_t const HEADER_SIZE =
+    sizeof(REGION_MAGIC) + sizeof(uint32_t) + sizeof(int32_t) +
+    RegionStore::REGION_SIZE * RegionStore::REGION_SIZE * 2 * sizeof(uint32_t);
+
+// heights are stored as fixed point with this many steps per unit
+static float const HEIGHT_SCALE = 128.f;
+
+static uint8_t const FLAG_SKELETON = 0b01;
+static uint8_t const FLAG_EDITED   = 0b10;
+
+static int16_t quantizeHeight(float const height) {
+    return (int16_t)std::clamp(std::round(height * HEIGHT_SCALE), -32768.f, 32767.f);
+}
+
+/**
+ * @brief Packs a chunk's tiles as a flags byte, fixed point heights (the ones around it too),
+ * then the tile types as (run length, type) pairs, since they're mostly long runs of grass
+ */
+static std::vector<uint8_t> encodeChunk(Chunk const & chunk) {
+    std::vector<uint8_t> ret;
+    ret.reserve(1 + (chunk.heights.size() + chunk.borderHeights.size()) * sizeof(int16_t) + 16);
+
+    ret.push_back(
+        (chunk.isSkeleton? FLAG_SKELETON : 0)
+      | (chunk.edited? FLAG_EDITED : 0)
+    );
+
+    auto const pushHeight = [&](float const height) {
+        auto const quantized = quantizeHeight(height);
+        uint8_t bytes[sizeof(quantized)];
+        std::memcpy(bytes, &quantized, sizeof(quantized));
+        ret.insert(ret.end(), std::begin(bytes), std::end(bytes));
+    };
+    for(std::size_t i = 0; i < chunk.heights.size(); i++) pushHeight(chunk.height(i));
+    for(auto const height: chunk.borderHeights) pushHeight(height);
+
+    for(std::size_t i = 0; i < chunk.types.size();) {
+        auto const type = chunk.types[i];
+        std::size_t run = 1;
+        while(i + run < chunk.types.size() && run < 255 && chunk.types[i + run] == type) run++;
+
+        ret.push_back((uint8_t)run);
+        ret.push_back((uint8_t)type);
+        i += run;
+    }
+
+    return ret;
+}
+
+static std::optional<Chunk> decodeChunk(uint8_t const * data, std::size_t const size) {
+    Chunk ret;
+    std::size_t const heightsSize = (ret.heights.size() + ret.borderHeights.size()) * sizeof(int16_t);
+    if(size < 1 + heightsSize) return std::nullopt;
+
+    ret.isSkeleton = data[0] & FLAG_SKELETON;
+    ret.edited = data[0] & FLAG_EDITED;
+    data++;
+
+    auto const readHeight = [&]() {
+        int16_t height;
+        std::memcpy(&height, data, sizeof(height));
+        data += sizeof(height);
+        return height / HEIGHT_SCALE;
+    };
+    for(std::size_t i = 0; i < ret.heights.size(); i++) ret.setHeight(i, readHeight());
+    for(auto& height: ret.borderHeights) height = readHeight();
+
+    auto const runsEnd = data + (size - 1 - heightsSize);
+    std::size_t i = 0;
+    for(; data + 1 < runsEnd; data += 2) {
+        for(std::size_t run = data[0]; run > 0 && i < ret.types.size(); run--) {
+            ret.types[i++] = (Tile::Type)data[1];
+        }
+    }
+    if(i != ret.types.size()) return std::nullopt;
+
+    return ret;
+}
+
+RegionStore::RegionStore(std::filesystem::path const & directory, int const seed)
+    : directory(directory)
+    , seed(seed)
+{
+    std::filesystem::create_directories(directory);
+    this->flushThread = std::thread([this](){ this->flushLoop(); });
+}
+
+RegionStore::~RegionStore() {
+    {
+        std::lock_guard lock(this->pendingMutex);
+        this->stopping = true;
+    }
+    this->pendingCondition.notify_one();
+    this->flushThread.join();
+
+    for(auto& [_, region]: this->regions) region.unmap();
+}
+
+void RegionStore::save(int const chunkX, int const chunkZ, Chunk const & chunk) {
+    auto data = encodeChunk(chunk);
+    {
+        std::lock_guard lock(this->pendingMutex);
+        this->pending.insert_or_assign({chunkX, chunkZ}, std::move(data));
+    }
+    this->pendingCondition.notify_one();
+}
+
+std::optional<Chunk> RegionStore::load(int const chunkX, int const chunkZ) {
+    std::optional<std::vector<uint8_t>> data;
+    {
+        std::lock_guard fileLock(this->fileMutex);
+        {
+            // the flush thread can't be halfway through writing it, since that needs fileMutex
+            std::lock_guard pendingLock(this->pendingMutex);
+            if(auto found = this->pending.find({chunkX, chunkZ}); found != this->pending.end()) {
+                data = found->second;
+            }
+        }
+
+        if(!data.has_value()) {
+            auto const [regionX, localX] = floorDivMod(chunkX, REGION_SIZE);
+            auto const [regionZ, localZ] = floorDivMod(chunkZ, REGION_SIZE);
+            data = this->read(this->openRegion(regionX, regionZ), localZ * REGION_SIZE + localX);
+        }
+    }
+
+    if(!data.has_value()) return std::nullopt;
+    return decodeChunk(data->data(), data->size());
+}
+
+void RegionStore::flushLoop() {
+    while(true) {
+        {
+            std::unique_lock lock(this->pendingMutex);
+            this->pendingCondition.wait(lock, [this](){ return this->stopping || !this->pending.empty(); });
+            if(this->pending.empty()) return; // only when stopping, so everything gets written first
+        }
+
+        // one chunk at a time, so a load on the main thread never has to wait long
+        std::pair<int, int> coord;
+        std::vector<uint8_t> data;
+        bool written;
+        {
+            std::lock_guard fileLock(this->fileMutex);
+            {
+                std::lock_guard pendingLock(this->pendingMutex);
+                auto next = this->pending.begin();
+                coord = next->first;
+                data = std::move(next->second);
+                this->pending.erase(next);
+            }
+
+            auto const [regionX, localX] = floorDivMod(coord.first, REGION_SIZE);
+            auto const [regionZ, localZ] = floorDivMod(coord.second, REGION_SIZE);
+            written = this->write(this->openRegion(regionX, regionZ), localZ * REGION_SIZE + localX, data);
+
+            if(!written) {
+                // back in the queue so loads still find it, unless it was saved again in the meantime
+                std::lock_guard pendingLock(this->pendingMutex);
+                this->pending.try_emplace(coord, std::move(data));
+            }
+        }
+
+        if(!written) {
+            std::unique_lock lock(this->pendingMutex);
+            if(this->stopping) {
+                fprintf(stderr, "Giving up on saving %zu chunks\n", this->pending.size());
+                return;
+            }
+            // no point hammering a full or read only disk, give it a moment before trying again
+            this->pendingCondition.wait_for(lock, std::chrono::seconds(5), [this](){ return this->stopping; });
+        }
+    }
+}
+
+RegionStore::RegionFile& RegionStore::openRegion(int const regionX, int const regionZ) {
+    if(auto found = this->regions.find({regionX, regionZ}); found != this->regions.end()) {
+        return found->second;
+    }
+
+    auto& region = this->regions[{regionX, regionZ}];
+    region.path = this->directory / ("r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".region");
+    region.table.fill({0, 0});
+
+    region.file.open(region.path, std::ios::binary | std::ios::in | std::ios::out);
+    if(region.file) {
+        char magic[sizeof(REGION_MAGIC)];
+        uint32_t version;
+        int32_t fileSeed;
+        region.file.read(magic, sizeof(magic));
+        region.file.read((char*)&version, sizeof(version));
+        region.file.read((char*)&fileSeed, sizeof(fileSeed));
+        region.file.read((char*)region.table.data(), region.table.size() * sizeof(TableEntry));
+
+        if(region.file
+        && std::memcmp(magic, REGION_MAGIC, sizeof(magic)) == 0
+        && version == REGION_VERSION
+        && fileSeed == this->seed
+        ) {
+            region.fileSize = std::filesystem::file_size(region.path);
+            return region;
+        }
+
+        // from a different world (or just broken), so it gets started over
+        region.table.fill({0, 0});
+    }
+
+    region.file.close();
+    region.file.clear();
+    region.file.open(region.path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    int32_t const fileSeed = this->seed;
+    region.file.write(REGION_MAGIC, sizeof(REGION_MAGIC));
+    region.file.write((char const *)&REGION_VERSION, sizeof(REGION_VERSION));
+    region.file.write((char const *)&fileSeed, sizeof(fileSeed));
+    region.file.write((char const *)region.table.data(), region.table.size() * sizeof(TableEntry));
+    region.file.flush();
+
+    if(!region.file) {
+        // left at 0 so nothing gets read out of it. Every write fails on the closed file,
+        // so its chunks stay queued rather than landing somewhere the header should be
+        fprintf(stderr, "Could not create region file %s\n", region.path.string().c_str());
+        region.file.close();
+        return region;
+    }
+    region.fileSize = HEADER_SIZE;
+
+    return region;
+}
+
+bool RegionStore::write(RegionFile& region, std::size_t const index, std::vector<uint8_t> const & data) {
+    auto entry = region.table[index];
+
+    // reuse the old spot if it fits, otherwise it goes on the end of the file
+    if(entry.size == 0 || data.size() > entry.size) {
+        entry.offset = region.fileSize;
+    }
+    entry.size = data.size();
+
+    // flushed before anything else happens, since reads go through a mapping of what's on disk
+    region.file.seekp(entry.offset);
+    region.file.write((char const *)data.data(), data.size());
+    region.file.flush();
+    if(!region.file) {
+        fprintf(stderr, "Could not write a chunk to %s\n", region.path.string().c_str());
+        region.file.clear();
+        return false;
+    }
+
+    region.file.seekp(HEADER_SIZE - region.table.size() * sizeof(TableEntry) + index * sizeof(TableEntry));
+    region.file.write((char const *)&entry, sizeof(TableEntry));
+    region.file.flush();
+    if(!region.file) {
+        fprintf(stderr, "Could not update the table of %s\n", region.path.string().c_str());
+        region.file.clear();
+        return false;
+    }
+
+    region.table[index] = entry;
+    region.fileSize = std::max<std::size_t>(region.fileSize, entry.offset + entry.size);
+    return true;
+}
+
+std::optional<std::vector<uint8_t>> RegionStore::read(RegionFile& region, std::size_t const index) {
+    auto const entry = region.table[index];
+    if(entry.size == 0) return std::nullopt;
+
+#ifndef _WIN32
+    // the file only ever grows, so the mapping only needs to be redone when
+    // something was written past the end of it
+    if(entry.offset + entry.size > region.mappingSize) {
+        region.unmap();
+
+        int const fd = open(region.path.c_str(), O_RDONLY);
+        if(fd < 0) return std::nullopt;
+        auto const mapping = mmap(nullptr, region.fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(mapping == MAP_FAILED) return std::nullopt;
+
+        region.mapping = mapping;
+        region.mappingSize = region.fileSize;
+    }
+
+    auto const begin = (uint8_t const *)region.mapping + entry.offset;
+    return std::vector<uint8_t>(begin, begin + entry.size);
+#else
+    std::vector<uint8_t> ret(entry.size);
+    region.file.seekg(entry.offset);
+    region.file.read((char*)ret.data(), ret.size());
+    if(!region.file) {
+        region.file.clear();
+        return std::nullopt;
+    }
+    return ret;
+#endif
+}
+
+void RegionStore::RegionFile::unmap() {
+#ifndef _WIN32
+    if(this->mapping) munmap(this->mapping, this->mappingSize);
+#endif
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+struct Chunk;
+
+/**
+ * @brief Keeps chunks on disk between sessions
+ * Chunks are grouped into region files of REGION_SIZE x REGION_SIZE chunks, each starting
+ * with a table of where in the file every chunk is. Writes are queued up and done on a
+ * background thread, reads are done straight from a memory mapping of the file
+ */
+struct RegionStore {
+    static int const REGION_SIZE = 32;
+
+    RegionStore(std::filesystem::path const & directory, int const seed);
+    ~RegionStore();
+
+    RegionStore(RegionStore const &) = delete;
+    RegionStore& operator=(RegionStore const &) = delete;
+
+    /**
+     * @brief Queues a chunk to be written
+     * The chunk is encoded right away, so it can be changed or destroyed afterwards
+     *
+     * @param chunkX
+     * @param chunkZ
+     * @param chunk
+     */
+    void save(int const chunkX, int const chunkZ, Chunk const & chunk);
+
+    /**
+     * @brief Reads a chunk, including ones that are still waiting to be written
+     *
+     * @param chunkX
+     * @param chunkZ
+     * @return std::optional<Chunk>. Will be nullopt if the chunk was never saved
+     */
+    std::optional<Chunk> load(int const chunkX, int const chunkZ);
+
+private:
+    struct TableEntry {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    struct RegionFile {
+        std::filesystem::path path;
+        std::array<TableEntry, REGION_SIZE * REGION_SIZE> table;
+        // only ever moved past what has actually made it into the file
+        std::size_t fileSize = 0;
+        // kept open for as long as the store is, rather than reopened for every chunk
+        std::fstream file;
+
+        void * mapping = nullptr;
+        std::size_t mappingSize = 0;
+
+        void unmap();
+    };
+
+    std::filesystem::path const directory;
+    int const seed;
+
+    // held while touching the files. Always taken before pendingMutex
+    std::mutex fileMutex;
+    std::map<std::pair<int, int>, RegionFile> regions;
+
+    std::mutex pendingMutex;
+    std::condition_variable pendingCondition;
+    std::map<std::pair<int, int>, std::vector<uint8_t>> pending;
+    bool stopping = false;
+
+    std::thread flushThread;
+
+    void flushLoop();
+
+    RegionFile& openRegion(int const regionX, int const regionZ);
+    /**
+     * @brief Writes a chunk and then its table entry
+     * The table is only updated once the chunk is in the file
+     *
+     * @param region
+     * @param index
+     * @param data
+     * @return bool. false if it couldn't be written, with nothing changed
+     */
+    bool write(RegionFile& region, std::size_t const index, std::vector<uint8_t> const & data);
+    std::optional<std::vector<uint8_t>> read(RegionFile& region, std::size_t const index);
+};
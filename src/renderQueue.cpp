@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+#include "renderQueue.h"
+#include "rendererState.h"
+
+void RenderQueue::push(
+    bgfx::ViewId const view,
+    bgfx::ProgramHandle const program,
+    uint64_t const state,
+    Model::Primitive const & prim,
+    Mat4 const & transform,
+    float const cameraDistance
+) {
+    this->packets.push_back({
+        .key = RenderQueue::sortKey(view, program, cameraDistance, prim),
+        .view = view,
+        .program = program,
+        .state = state,
+        .vertexBuffer = prim.vertexBuffer,
+        .indexBuffer = prim.indexBuffer,
+        .heightmap = prim.heightmap,
+        .transform = transform,
+        .instances = std::nullopt,
+    });
+}
+
+void RenderQueue::pushInstanced(
+    bgfx::ViewId const view,
+    bgfx::ProgramHandle const program,
+    uint64_t const state,
+    Model::Primitive const & prim,
+    bgfx::InstanceDataBuffer const & instances,
+    float const cameraDistance
+) {
+    this->packets.push_back({
+        .key = RenderQueue::sortKey(view, program, cameraDistance, prim),
+        .view = view,
+        .program = program,
+        .state = state,
+        .vertexBuffer = prim.vertexBuffer,
+        .indexBuffer = prim.indexBuffer,
+        .heightmap = prim.heightmap,
+        .transform = IDENTITY_MTX,
+        .instances = instances,
+    });
+}
+
+uint64_t RenderQueue::sortKey(
+    bgfx::ViewId const view, 
+    bgfx::ProgramHandle const program, 
+    float const cameraDistance, 
+    Model::Primitive const & prim
+) {
+    // the shadow view doesn't care what order things are drawn in, so it's
+    // left grouped by vertex buffer instead
+    uint64_t const depth = view == RENDER_SCENE_ID?
+        (uint64_t)(std::clamp(cameraDistance / FAR_CLIP, 0.f, 1.f) * 0xffffff)
+            :
+        0;
+    uint64_t const vertexBuffer = std::visit([](auto const handle){ return (uint64_t)handle.idx; }, prim.vertexBuffer);
+
+    return ((uint64_t)view        << 56)
+         | ((uint64_t)program.idx << 40)
+         | (depth                 << 16)
+         | (vertexBuffer & 0xffff);
+}
+
+void RenderQueue::flush(FrameState const & frame, WorkerPool& workers) {
+    std::sort(this->packets.begin(), this->packets.end(), [](auto const & a, auto const & b) {
+        return a.key < b.key;
+    });
+
+    // not worth waking up a thread for less than this
+    std::size_t const MIN_PACKETS_PER_JOB = 64;
+    std::size_t const jobs = std::clamp<std::size_t>(this->packets.size() / MIN_PACKETS_PER_JOB, 1, workers.size());
+    // slices that couldn't get an encoder, because something else was holding onto them
+    std::mutex leftoverMutex;
+    std::vector<std::pair<std::size_t, std::size_t>> leftovers;
+    workers.run(jobs, [&](std::size_t const job) {
+        std::size_t const begin = this->packets.size() * job / jobs;
+        std::size_t const end = this->packets.size() * (job + 1) / jobs;
+
+        auto const encoder = bgfx::begin(true);
+        if(!encoder) {
+            std::lock_guard lock(leftoverMutex);
+            leftovers.push_back({begin, end});
+            return;
+        }
+        this->submit(encoder, frame, begin, end);
+        bgfx::end(encoder);
+    });
+
+    // every job's given its encoder back by now, so one of them can do the rest
+    if(!leftovers.empty()) {
+        auto const encoder = bgfx::begin(true);
+        if(encoder) {
+            for(auto const & [begin, end]: leftovers) this->submit(encoder, frame, begin, end);
+            bgfx::end(encoder);
+        } else {
+            fprintf(stderr, "Out of bgfx encoders, %zu slices of draws weren't submitted\n", leftovers.size());
+        }
+    }
+
+    this->packets.clear();
+}
+
+void RenderQueue::submit(
+    bgfx::Encoder * const encoder,
+    FrameState const & frame,
+    std::size_t const begin,
+    std::size_t const end
+) const {
+    // the same for every draw this frame. Uniforms only carry over within an encoder, so each
+    // one needs them set
+    encoder->setUniform(rendererState.uniforms.u_lightMapMtx, frame.lightMapMtx.data());
+    encoder->setUniform(rendererState.uniforms.u_lightDirMtx, frame.lightViewMtx.data());
+    encoder->setUniform(rendererState.uniforms.u_palette, rendererState.terrainPalette.data(), rendererState.terrainPalette.size());
+
+    // bgfx's handles can't be compared, so they're compared by their type and index instead
+    auto const vertexBufferId = [](auto const & buffer) {
+        return std::make_pair(buffer.index(), std::visit([](auto const handle){ return handle.idx; }, buffer));
+    };
+
+    uint8_t const keepable = 
+        BGFX_DISCARD_STATE 
+      | BGFX_DISCARD_TRANSFORM 
+      | BGFX_DISCARD_VERTEX_STREAMS 
+      | BGFX_DISCARD_INDEX_BUFFER 
+      | BGFX_DISCARD_BINDINGS;
+    // whatever the last submit left set
+    uint8_t kept = 0;
+
+    for(std::size_t i = begin; i < end; i++) {
+        auto const & packet = this->packets[i];
+
+        if(!(kept & BGFX_DISCARD_STATE)) encoder->setState(packet.state);
+        if(!(kept & BGFX_DISCARD_TRANSFORM) && !packet.instances.has_value()) {
+            encoder->setTransform(packet.transform.data());
+            encoder->setUniform(rendererState.uniforms.u_modelMtx, packet.transform.data());
+        }
+        if(!(kept & BGFX_DISCARD_VERTEX_STREAMS)) {
+            std::visit([&](auto const handle){ encoder->setVertexBuffer(0, handle); }, packet.vertexBuffer);
+        }
+        if(!(kept & BGFX_DISCARD_INDEX_BUFFER)) encoder->setIndexBuffer(packet.indexBuffer);
+        if(!(kept & BGFX_DISCARD_BINDINGS)) {
+            // not in the shadow views, they're drawing to the shadow maps
+            if(packet.view == RENDER_SCENE_ID) {
+                encoder->setTexture(0, rendererState.uniforms.u_shadowMap, rendererState.shadowMap);
+                encoder->setTexture(2, rendererState.uniforms.u_shadowTint, rendererState.shadowTint);
+                encoder->setTexture(3, rendererState.uniforms.u_blueNoise, rendererState.blueNoise);
+            }
+            if(packet.heightmap.has_value()) encoder->setTexture(1, rendererState.uniforms.u_heightmap, packet.heightmap.value());
+        }
+        if(packet.instances.has_value()) encoder->setInstanceDataBuffer(&packet.instances.value());
+
+        // only keep what the next packet would set the same anyways
+        uint8_t discard = BGFX_DISCARD_ALL;
+        if(i + 1 < end) {
+            auto const & next = this->packets[i + 1];
+            if(next.state == packet.state) discard &= ~BGFX_DISCARD_STATE;
+            if(vertexBufferId(next.vertexBuffer) == vertexBufferId(packet.vertexBuffer)) discard &= ~BGFX_DISCARD_VERTEX_STREAMS;
+            if(next.indexBuffer.idx == packet.indexBuffer.idx) discard &= ~BGFX_DISCARD_INDEX_BUFFER;
+            if(next.view == packet.view && next.heightmap.has_value() == packet.heightmap.has_value()
+            && (!next.heightmap.has_value() || next.heightmap->idx == packet.heightmap->idx)
+            ) {
+                discard &= ~BGFX_DISCARD_BINDINGS;
+            }
+            if(!next.instances.has_value() && !packet.instances.has_value() && next.transform == packet.transform) {
+                discard &= ~BGFX_DISCARD_TRANSFORM;
+            }
+        }
+
+        // the encoders' draws get interleaved, so bgfx puts them back in order with the
+        // same depth the key was sorted by
+        encoder->submit(packet.view, packet.program, (packet.key >> 16) & 0xffffff, discard);
+        kept = ~discard & keepable;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <optional>
+#include <variant>
+#include <vector>
+#include <bgfx/bgfx.h>
+
+#include "model.h"
+#include "mathUtils.h"
+#include "frameState.h"
+#include "workerPool.h"
+
+/**
+ * @brief Collects a frame's draws so they can be sorted before they're submitted
+ * Draws that end up next to each other only set whatever state differs between them,
+ * and the uniforms that are the same for the whole frame are only set once.
+ * Submitting is split over a few threads, each with its own bgfx::Encoder
+ */
+struct RenderQueue {
+    /**
+     * @brief Queues a primitive to be drawn
+     * 
+     * @param view 
+     * @param program 
+     * @param state 
+     * @param prim 
+     * @param transform 
+     * @param cameraDistance only used to sort the scene view, front to back
+     */
+    void push(
+        bgfx::ViewId const view,
+        bgfx::ProgramHandle const program,
+        uint64_t const state,
+        Model::Primitive const & prim,
+        Mat4 const & transform,
+        float const cameraDistance
+    );
+
+    /**
+     * @brief Queues a primitive to be drawn once per instance
+     * 
+     * @param view 
+     * @param program 
+     * @param state 
+     * @param prim 
+     * @param instances has to have been allocated this frame
+     * @param cameraDistance of the nearest instance
+     */
+    void pushInstanced(
+        bgfx::ViewId const view,
+        bgfx::ProgramHandle const program,
+        uint64_t const state,
+        Model::Primitive const & prim,
+        bgfx::InstanceDataBuffer const & instances,
+        float const cameraDistance
+    );
+
+    /**
+     * @brief Sorts and submits everything queued, then empties the queue
+     * Only uses bgfx::Encoders, so it can be called from any thread
+     * 
+     * @param frame where the frame-wide uniforms come from
+     * @param workers to submit with, each job getting its own encoder. Has to have fewer
+     * threads than bgfx has encoders
+     */
+    void flush(FrameState const & frame, WorkerPool& workers);
+
+private:
+    struct Packet {
+        // view, then program, then how far from the camera, then vertex buffer
+        uint64_t key;
+        bgfx::ViewId view;
+        bgfx::ProgramHandle program;
+        uint64_t state;
+        std::variant<bgfx::VertexBufferHandle, bgfx::DynamicVertexBufferHandle> vertexBuffer;
+        bgfx::IndexBufferHandle indexBuffer;
+        std::optional<bgfx::TextureHandle> heightmap;
+        Mat4 transform;
+        std::optional<bgfx::InstanceDataBuffer> instances;
+    };
+
+    std::vector<Packet> packets;
+
+    /**
+     * @brief Submits packets [begin, end) through one encoder
+     */
+    void submit(
+        bgfx::Encoder * const encoder,
+        FrameState const & frame,
+        std::size_t const begin,
+        std::size_t const end
+    ) const;
+
+    static uint64_t sortKey(
+        bgfx::ViewId const view, 
+        bgfx::ProgramHandle const program, 
+        float const cameraDistance, 
+        Model::Primitive const & prim
+    );
+};
@@ -1,8 +1,12 @@
 #include <bgfx/bgfx.h>
 #include <bgfx/platform.h>
 #include <bx/math.h> // NOLINT(modernize-deprecated-headers)
+#include <algorithm>
+#include <cmath>
+#include <thread>
 
 #include "rendererState.h"
+#include "blueNoise.h"
 #include "config.h"
 #include "gui.h"
 
@@ -35,8 +39,8 @@ SDL_Window* initWindow() {
 }
 
 void initBgfx(SDL_Window * const window) {
-    bgfx::renderFrame();
-
+    // bgfx::renderFrame isn't called before init, so bgfx starts its own render thread and
+    // the GL work for a frame happens while the next one is being put together
     bgfx::Init i;
 
     SDL_SysWMinfo wndwInfo;
@@ -66,6 +70,8 @@ void initBgfx(SDL_Window * const window) {
     );
 }
 
+static uint32_t const WHITE_TEXEL = 0xffffffff;
+
 RendererState RendererState::init() {
     RendererState ret;
     
@@ -101,6 +107,62 @@ RendererState RendererState::init() {
         return bgfx::createProgram(vertShader, fragShader, true);
     }();
 
+    ret.terrainProgram = [](){
+        auto vertShader = [](){
+            #include "../shaderBuild/vertTerrain.h"
+            return createShaderFromArray(vertTerrain, sizeof(vertTerrain));
+        }();
+
+        auto fragShader = [](){
+            #include "../shaderBuild/frag.h"
+            return createShaderFromArray(frag, sizeof(frag));
+        }();
+
+        return bgfx::createProgram(vertShader, fragShader, true);
+    }();
+
+    ret.terrainShadowProgram = [](){
+        auto vertShader = [](){
+            #include "../shaderBuild/vertTerrainShadowmap.h"
+            return createShaderFromArray(vertTerrainShadowmap, sizeof(vertTerrainShadowmap));
+        }();
+
+        auto fragShader = [](){
+            #include "../shaderBuild/fragShadowmap.h"
+            return createShaderFromArray(fragShadowmap, sizeof(fragShadowmap));
+        }();
+
+        return bgfx::createProgram(vertShader, fragShader, true);
+    }();
+
+    ret.sceneInstancedProgram = [](){
+        auto vertShader = [](){
+            #include "../shaderBuild/vertInstanced.h"
+            return createShaderFromArray(vertInstanced, sizeof(vertInstanced));
+        }();
+
+        auto fragShader = [](){
+            #include "../shaderBuild/frag.h"
+            return createShaderFromArray(frag, sizeof(frag));
+        }();
+
+        return bgfx::createProgram(vertShader, fragShader, true);
+    }();
+
+    ret.shadowInstancedProgram = [](){
+        auto vertShader = [](){
+            #include "../shaderBuild/vertShadowmapInstanced.h"
+            return createShaderFromArray(vertShadowmapInstanced, sizeof(vertShadowmapInstanced));
+        }();
+
+        auto fragShader = [](){
+            #include "../shaderBuild/fragShadowmap.h"
+            return createShaderFromArray(fragShadowmap, sizeof(fragShadowmap));
+        }();
+
+        return bgfx::createProgram(vertShader, fragShader, true);
+    }();
+
     ret.screenProgram = [](){
         auto vertShader = [](){
             #include "../shaderBuild/vertScreen.h"
@@ -115,6 +177,22 @@ RendererState RendererState::init() {
         return bgfx::createProgram(vertShader, fragShader, true);
     }();
 
+    ret.upscaleProgram = [](){
+        auto vertShader = [](){
+            #include "../shaderBuild/vertScreen.h"
+            return createShaderFromArray(vertScreen, sizeof(vertScreen));
+        }();
+
+        auto fragShader = [](){
+            #include "../shaderBuild/fragUpscale.h"
+            return createShaderFromArray(fragUpscale, sizeof(fragUpscale));
+        }();
+
+        return bgfx::createProgram(vertShader, fragShader, true);
+    }();
+
+    auto const screenDepthFormat = bgfx::isTextureValid(0, false, 1, bgfx::TextureFormat::D32F, BGFX_TEXTURE_RT)? 
+        bgfx::TextureFormat::D32F : bgfx::TextureFormat::D24;
     ret.screenBuffer = [&](){
         std::vector<bgfx::TextureHandle> screenTextures = {
             bgfx::createTexture2D( // visuals
@@ -138,8 +216,7 @@ RendererState RendererState::init() {
                 config.graphics.resolutionY, 
                 false, 
                 1, 
-                bgfx::isTextureValid(0, false, 1, bgfx::TextureFormat::D32F, BGFX_TEXTURE_RT)? 
-                bgfx::TextureFormat::D32F : bgfx::TextureFormat::D24, 
+                screenDepthFormat, 
                 BGFX_TEXTURE_RT
             ),
         };
@@ -156,46 +233,131 @@ RendererState RendererState::init() {
         ret.screenDepth = screenTextures.at(2);
         return bgfx::createFrameBuffer(screenAttachments.size(), screenAttachments.data(), true);
     }();
+    // blits need the same format on both ends
+    ret.depthReadback = ReadbackRing(screenDepthFormat);
+
+    {
+        // bgfx keeps one encoder for the main thread's own draws (the screen, gui), and
+        // the submit thread takes a job itself
+        std::size_t const encoders = bgfx::getCaps()->limits.maxEncoders;
+        std::size_t const threads = std::max(std::thread::hardware_concurrency(), 1u);
+        ret.renderWorkers = std::make_unique<WorkerPool>(std::clamp<std::size_t>(encoders, 2, threads + 1) - 2);
+        ret.submitThread = std::make_unique<WorkerPool>(1);
+    }
+
+    ret.frameBudget = FrameBudget(
+        config.graphics.gpuFrameBudget / 1000.f, 
+        config.graphics.dynamicResolution? config.graphics.minResolutionScale : 1.f
+    );
+    ret.renderDistanceBudget = config.graphics.adaptiveRenderDistance?
+        RenderDistanceBudget(
+            config.graphics.frameTimeBudget / 1000.f,
+            config.graphics.minRenderDistance,
+            config.graphics.maxRenderDistance,
+            config.graphics.renderDistance
+        )
+            :
+        RenderDistanceBudget(1.f, config.graphics.renderDistance, config.graphics.renderDistance, config.graphics.renderDistance);
+
+    ret.cacheStaticShadows = bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_BLIT;
+
+    // depth only, compared by the sampler. Tinted shadows get a color attachment
+    // too, which the casters MIN blend their tint into
+    auto const createShadowBuffer = [&](bgfx::TextureHandle& outDepth, bgfx::TextureHandle& outTint, uint64_t const flags) {
+        auto const depthFormat = bgfx::isTextureValid(0, false, 1, bgfx::TextureFormat::D16, BGFX_TEXTURE_RT | BGFX_SAMPLER_COMPARE_LEQUAL)?
+            bgfx::TextureFormat::D16 : bgfx::TextureFormat::D24;
 
-    ret.shadowMapBuffer = [&](){
-        std::vector<bgfx::TextureHandle> shadowMaps = {
-            bgfx::createTexture2D(
+        std::vector<bgfx::TextureHandle> shadowMaps;
+        if(config.graphics.tintedShadows) {
+            outTint = bgfx::createTexture2D(
                 config.graphics.shadowMapResolution,
                 config.graphics.shadowMapResolution,
                 false,
                 1,
                 bgfx::TextureFormat::RGBA8,
-                BGFX_TEXTURE_RT
-            )
-        };
+                BGFX_TEXTURE_RT | flags
+            );
+            shadowMaps.push_back(outTint);
+        }
+        outDepth = bgfx::createTexture2D(
+            config.graphics.shadowMapResolution,
+            config.graphics.shadowMapResolution,
+            false,
+            1,
+            depthFormat,
+            BGFX_TEXTURE_RT | BGFX_SAMPLER_COMPARE_LEQUAL | flags
+        );
+        shadowMaps.push_back(outDepth);
 
-        ret.shadowMap = shadowMaps.at(0);
         return bgfx::createFrameBuffer(shadowMaps.size(), shadowMaps.data(), true);
-    }();
+    };
+
+    if(!(bgfx::getCaps()->supported & (BGFX_CAPS_TEXTURE_COMPARE_LEQUAL | BGFX_CAPS_TEXTURE_COMPARE_ALL))) {
+        fprintf(stderr, "Shadow map depth comparison isn't supported, shadows won't look right\n");
+    }
 
-    bx::mtxIdentity(ret.cameraMtx.data());
-    ret.cameraPos = {0.f, 0.f, 0.f};
+    // without tinted shadows the scene is still given something to sample, it's just white
+    if(!config.graphics.tintedShadows) {
+        ret.shadowTint = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8, 0, bgfx::copy(&WHITE_TEXEL, sizeof(WHITE_TEXEL)));
+        ret.staticShadowTint = ret.shadowTint;
+    }
+    ret.shadowMapBuffer = createShadowBuffer(ret.shadowMap, ret.shadowTint, BGFX_TEXTURE_BLIT_DST);
+    ret.staticShadowMapBuffer = createShadowBuffer(ret.staticShadowMap, ret.staticShadowTint, 0);
+
+    {
+        // the ranks are turned into angles, stored as their cos and sin so the shader
+        // doesn't have to do any trig for it
+        auto const ranks = generateBlueNoise(0x5eed);
+        auto const memory = bgfx::alloc(ranks.size() * 2);
+        for(std::size_t i = 0; i < ranks.size(); i++) {
+            float const angle = (float)ranks[i] / ranks.size() * 2.f * bx::kPi;
+            memory->data[i * 2 + 0] = (uint8_t)std::round((std::cos(angle) * 0.5f + 0.5f) * 255.f);
+            memory->data[i * 2 + 1] = (uint8_t)std::round((std::sin(angle) * 0.5f + 0.5f) * 255.f);
+        }
+        ret.blueNoise = bgfx::createTexture2D(
+            BLUE_NOISE_SIZE,
+            BLUE_NOISE_SIZE,
+            false,
+            1,
+            bgfx::TextureFormat::RG8,
+            BGFX_SAMPLER_POINT,
+            memory
+        );
+    }
 
     bgfx::setViewRect(RENDER_SCENE_ID, 0, 0, config.graphics.resolutionX, config.graphics.resolutionY);
     bgfx::setViewFrameBuffer(RENDER_SCENE_ID, ret.screenBuffer);
     bgfx::setViewRect(RENDER_SHADOW_ID, 0, 0, config.graphics.shadowMapResolution, config.graphics.shadowMapResolution);
     bgfx::setViewFrameBuffer(RENDER_SHADOW_ID, ret.shadowMapBuffer);
+    bgfx::setViewRect(RENDER_STATIC_SHADOW_ID, 0, 0, config.graphics.shadowMapResolution, config.graphics.shadowMapResolution);
+    bgfx::setViewFrameBuffer(RENDER_STATIC_SHADOW_ID, ret.staticShadowMapBuffer);
     bgfx::setViewRect(RENDER_SCREEN_ID, 0, 0, config.graphics.resolutionX, config.graphics.resolutionY);
+    // the render queue submits from several threads at once, so the order they arrive in
+    // is all mixed up. bgfx's own sort (program, then depth) puts it back the way the
+    // queue had it
+    bgfx::setViewMode(RENDER_SCENE_ID, bgfx::ViewMode::Default);
+    bgfx::setViewMode(RENDER_SHADOW_ID, bgfx::ViewMode::Default);
+    bgfx::setViewMode(RENDER_STATIC_SHADOW_ID, bgfx::ViewMode::Default);
 
     ret.uniforms = {
         .u_shadowMap   = bgfx::createUniform("u_shadowMap", bgfx::UniformType::Sampler),
+        .u_shadowTint  = bgfx::createUniform("u_shadowTint", bgfx::UniformType::Sampler),
+        .u_blueNoise   = bgfx::createUniform("u_blueNoise", bgfx::UniformType::Sampler),
         .u_lightDirMtx = bgfx::createUniform("u_lightDirMtx", bgfx::UniformType::Mat4),
         .u_lightMapMtx = bgfx::createUniform("u_lightMapMtx", bgfx::UniformType::Mat4),
         .u_modelMtx    = bgfx::createUniform("u_modelMtx", bgfx::UniformType::Mat4),
         // why does bgfx not have float/int uniforms? ugh.
         .u_frame       = bgfx::createUniform("u_frame", bgfx::UniformType::Vec4),
-        .u_texture     = bgfx::createUniform("u_texture", bgfx::UniformType::Sampler)
+        .u_texture     = bgfx::createUniform("u_texture", bgfx::UniformType::Sampler),
+        .u_heightmap   = bgfx::createUniform("u_heightmap", bgfx::UniformType::Sampler),
+        .u_palette     = bgfx::createUniform("u_palette", bgfx::UniformType::Vec4, 6),
+        .u_upscale     = bgfx::createUniform("u_upscale", bgfx::UniformType::Vec4, 2),
     };
     
     return ret;
 }
 
-void RendererState::drawTextureToScreen(bgfx::TextureHandle texture, float const z) {
+void RendererState::drawTextureToScreen(bgfx::TextureHandle texture, float const z, float const scale) {
     bgfx::TransientVertexBuffer screenSpaceBuffer;
     bgfx::TransientIndexBuffer indices;
     bgfx::VertexLayout layout;
@@ -250,30 +412,126 @@ void RendererState::drawTextureToScreen(bgfx::TextureHandle texture, float const
     bgfx::setVertexBuffer(0, &screenSpaceBuffer);
     bgfx::setIndexBuffer(&indices);
     bgfx::setTexture(0, uniforms.u_texture, texture);
-    bgfx::submit(RENDER_SCREEN_ID, screenProgram);
+
+    // the upscale filter takes 5 samples a pixel, no point paying for it at full resolution
+    if(scale == 1.f) {
+        bgfx::submit(RENDER_SCREEN_ID, screenProgram);
+        return;
+    }
+
+    // GL puts the top left of the texture at the end
+    std::array<std::array<float, 4>, 2> const upscale = {{
+        {scale, scale, 0.f, bgfx::getCaps()->originBottomLeft? 1.f - scale : 0.f},
+        // sharpened more the blurrier it gets
+        {1.f / config.graphics.resolutionX, 1.f / config.graphics.resolutionY, (1.f - scale) * 0.5f, 0.f},
+    }};
+    bgfx::setUniform(uniforms.u_upscale, upscale.data(), upscale.size());
+    bgfx::submit(RENDER_SCREEN_ID, upscaleProgram);
 }
 
-void RendererState::finishRender() {
+std::optional<bgfx::ViewId> RendererState::staticShadowView() const {
+    if(!this->cacheStaticShadows) return RENDER_SHADOW_ID;
+    if(this->staticShadowsDirty) return RENDER_STATIC_SHADOW_ID;
+    return std::nullopt;
+}
+
+FrameState& RendererState::frameState() {
+    return this->frameStates[this->extractingIndex];
+}
+
+FrameState const & RendererState::frameState() const {
+    return this->frameStates[this->extractingIndex];
+}
+
+FrameState const & RendererState::lastFrameState() const {
+    return this->frameStates[(this->extractingIndex + 1) % this->frameStates.size()];
+}
+
+RenderQueue& RendererState::renderQueue() {
+    return this->renderQueues[this->extractingIndex];
+}
+
+void RendererState::submitFrame() {
+    auto& frame = this->frameState();
+
+    frame.resolutionScale = this->frameBudget.scale();
+    bgfx::setViewRect(
+        RENDER_SCENE_ID, 
+        0, 
+        0, 
+        config.graphics.resolutionX * frame.resolutionScale, 
+        config.graphics.resolutionY * frame.resolutionScale
+    );
+
+    bgfx::setViewTransform(RENDER_SCENE_ID, frame.cameraViewMtx.data(), frame.cameraProjectionMtx.data());
+    bgfx::setViewTransform(RENDER_SHADOW_ID, frame.lightViewMtx.data(), frame.lightProjectionMtx.data());
+    bgfx::setViewTransform(RENDER_STATIC_SHADOW_ID, frame.lightViewMtx.data(), frame.lightProjectionMtx.data());
+
+    if(this->cacheStaticShadows) {
+        // so it still gets cleared even if there's nothing in it
+        if(this->staticShadowsDirty) bgfx::touch(RENDER_STATIC_SHADOW_ID);
+        // blits happen before anything's drawn in the view, so the dynamic shadows go on top
+        bgfx::touch(RENDER_SHADOW_ID);
+        bgfx::blit(RENDER_SHADOW_ID, this->shadowMap, 0, 0, this->staticShadowMap);
+        if(config.graphics.tintedShadows) bgfx::blit(RENDER_SHADOW_ID, this->shadowTint, 0, 0, this->staticShadowTint);
+    }
+    // anything the simulation dirties from here on is for the next frame
+    this->staticShadowsDirty = false;
+
     bgfx::setScissor(0, 0, config.graphics.resolutionX, config.graphics.resolutionY);
-    this->drawTextureToScreen(screenTexture, -1.0f);
+    this->drawTextureToScreen(screenTexture, -1.0f, frame.resolutionScale);
 
     drawGui(lastFrameTimeElapsed);
 
+    this->submitThread->start(1, [this, index = this->extractingIndex](std::size_t const _job){
+        this->renderQueues[index].flush(this->frameStates[index], *this->renderWorkers);
+    });
+    this->submitting = true;
+
+    // the next frame starts off where this one is, in case the camera doesn't move
+    this->extractingIndex = (this->extractingIndex + 1) % this->frameStates.size();
+    this->frameState() = frame;
+}
+
+void RendererState::finishRender() {
+    if(!this->submitting) return;
+    this->submitThread->wait();
+    this->submitting = false;
+
     this->frame = bgfx::frame();
+    this->depthReadback.update(this->frame);
+
+    auto const stats = bgfx::getStats();
+    // 0 for GPUs without timer queries
+    float const gpuTime = stats->gpuTimerFreq > 0 && stats->gpuTimeEnd > stats->gpuTimeBegin?
+        (float)(stats->gpuTimeEnd - stats->gpuTimeBegin) / stats->gpuTimerFreq
+            :
+        0.f;
+    // all of the time between frames that wasn't spent waiting on the render thread
+    float const cpuTime = stats->cpuTimerFreq > 0?
+        (float)std::max<int64_t>(stats->cpuTimeFrame - stats->waitRender, 0) / stats->cpuTimerFreq
+            :
+        0.f;
+
+    // without timer queries it just stays at full resolution
+    if(config.graphics.dynamicResolution && gpuTime > 0.f) this->frameBudget.update(gpuTime);
 
     auto frameEnd = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> timeElapsed = frameEnd - frameStart;
     lastFrameTimeElapsed = timeElapsed.count();
     frameStart = frameEnd;
+
+    if(config.graphics.adaptiveRenderDistance) {
+        this->renderDistanceBudget.update(lastFrameTimeElapsed, cpuTime, gpuTime, this->frameBudget.scale() == 1.f);
+    }
 }
 
 void RendererState::setLightOrientation(bx::Vec3 from, bx::Vec3 to, float size, float depth){
-    Mat4 lightView;
-    bx::mtxLookAt(lightView.data(), from, to);
+    auto& frame = this->frameState();
 
-    Mat4 lightProjection;
+    bx::mtxLookAt(frame.lightViewMtx.data(), from, to);
     bx::mtxOrtho(
-        lightProjection.data(), 
+        frame.lightProjectionMtx.data(), 
         -size, 
         size, 
         -size, 
@@ -284,16 +542,19 @@ void RendererState::setLightOrientation(bx::Vec3 from, bx::Vec3 to, float size,
         bgfx::getCaps()->homogeneousDepth
     );
 
-    bgfx::setViewTransform(RENDER_SHADOW_ID, lightView.data(), lightProjection.data());
-    lightMapMtx = lightProjection * lightView;
-    bgfx::setUniform(this->uniforms.u_lightDirMtx, lightView.data());
+    // only actually moves when the player crosses into another chunk
+    auto const lightMapMtx = frame.lightProjectionMtx * frame.lightViewMtx;
+    if(lightMapMtx != frame.lightMapMtx) staticShadowsDirty = true;
+    frame.lightMapMtx = lightMapMtx;
+    frame.lightFrustum = Frustum::fromMatrix(frame.lightMapMtx, bgfx::getCaps()->homogeneousDepth);
 }
 
 void RendererState::setCameraOrientation(bx::Vec3 from, bx::Vec3 to) {
-    bx::mtxLookAt(cameraViewMtx.data(), from, to);
+    auto& frame = this->frameState();
 
+    bx::mtxLookAt(frame.cameraViewMtx.data(), from, to);
     bx::mtxProj(
-        cameraProjectionMtx.data(),
+        frame.cameraProjectionMtx.data(),
         (float)config.graphics.fieldOfView,
         (float)config.graphics.resolutionX/(float)config.graphics.resolutionY,
         NEAR_CLIP,
@@ -301,8 +562,8 @@ void RendererState::setCameraOrientation(bx::Vec3 from, bx::Vec3 to) {
         bgfx::getCaps()->homogeneousDepth
     );
 
-    bgfx::setViewTransform(RENDER_SCENE_ID, cameraViewMtx.data(), cameraProjectionMtx.data());
-    cameraPos = from;
-    cameraMtx = cameraProjectionMtx * cameraViewMtx;
+    frame.cameraPos = from;
+    frame.cameraMtx = frame.cameraProjectionMtx * frame.cameraViewMtx;
+    frame.cameraFrustum = Frustum::fromMatrix(frame.cameraMtx, bgfx::getCaps()->homogeneousDepth);
 }
 
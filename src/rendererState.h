@@ -4,17 +4,26 @@
 #include <bx/math.h> // NOLINT(modernize-deprecated-headers)
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_syswm.h>
+#include <array>
 #include <chrono>
+#include <memory>
+#include <optional>
 
 #include "model.h"
 #include "mathUtils.h"
+#include "renderQueue.h"
+#include "frameState.h"
+#include "readback.h"
+#include "frameBudget.h"
 
 char const * const WINDOW_NAME = "First bgfx";
 
 bgfx::ViewId const RENDER_SCENE_ID = 1;
 bgfx::ViewId const RENDER_SHADOW_ID = 0;
 bgfx::ViewId const RENDER_SCREEN_ID = 2;
-bgfx::ViewId const RENDER_BLIT_MOUSE_ID = 3;
+// copies out of the screen buffers, so it has to come after RENDER_SCENE_ID in the view order
+bgfx::ViewId const RENDER_READBACK_ID = 3;
+bgfx::ViewId const RENDER_STATIC_SHADOW_ID = 4;
 
 float const NEAR_CLIP = 1.3f;
 float const FAR_CLIP = 250.f;
@@ -34,34 +43,133 @@ struct RendererState {
 
     bgfx::ProgramHandle sceneProgram;
     bgfx::ProgramHandle shadowProgram;
+    bgfx::ProgramHandle terrainProgram;
+    bgfx::ProgramHandle sceneInstancedProgram;
+    bgfx::ProgramHandle shadowInstancedProgram;
+    bgfx::ProgramHandle terrainShadowProgram;
     bgfx::ProgramHandle screenProgram;
+    // screenProgram, but scales up from however much of the texture the scene was drawn over
+    bgfx::ProgramHandle upscaleProgram;
 
     bgfx::TextureHandle screenTexture;
     bgfx::TextureHandle screenData;
     bgfx::TextureHandle screenDepth;
     bgfx::FrameBufferHandle screenBuffer;
 
+    // depth, sampled with hardware comparison
     bgfx::TextureHandle shadowMap;
+    // what color the casters tint the light, only rendered to if config.graphics.tintedShadows
+    // is on. Otherwise it's a single white texel
+    bgfx::TextureHandle shadowTint;
     bgfx::FrameBufferHandle shadowMapBuffer;
 
-    Mat4 lightMapMtx;
-    Mat4 cameraViewMtx;
-    Mat4 cameraProjectionMtx;
-    Mat4 cameraMtx;
-    bx::Vec3 cameraPos;
+    // the shadows of things that don't move (terrain, decorations) get their own shadow
+    // map, which is only redrawn when they or the light change. It's copied into shadowMap
+    // each frame before everything else is drawn over it
+    bgfx::TextureHandle staticShadowMap;
+    bgfx::TextureHandle staticShadowTint;
+    bgfx::FrameBufferHandle staticShadowMapBuffer;
+    bool cacheStaticShadows;
+    bool staticShadowsDirty = true;
+
+    // a tiled rotation per pixel for the shadow samples, so the edges come out as
+    // fine even noise instead of stair steps. See generateBlueNoise
+    bgfx::TextureHandle blueNoise;
+
+    // one of each is filled in by the simulation while the other is submitted on another
+    // thread. extractingIndex says which is being filled in
+    std::array<FrameState, 2> frameStates;
+    // everything drawn in the shadow and scene views goes through these
+    std::array<RenderQueue, 2> renderQueues;
+    std::size_t extractingIndex = 0;
+    // flushes the render queues, one job per encoder
+    std::unique_ptr<WorkerPool> renderWorkers;
+    // a single thread the frame that was just filled in is flushed on, see submitFrame
+    std::unique_ptr<WorkerPool> submitThread;
+    // whether there's a frame waiting on finishRender
+    bool submitting = false;
+
+    // for reading screenDepth back, in RENDER_READBACK_ID
+    ReadbackRing depthReadback;
+
+    // how much of the screen buffers the scene is drawn over. Stays at full resolution
+    // unless config.graphics.dynamicResolution is on
+    FrameBudget frameBudget;
+    // how far out chunks are loaded and drawn. Stays at config.graphics.renderDistance
+    // unless config.graphics.adaptiveRenderDistance is on
+    RenderDistanceBudget renderDistanceBudget;
+
+    // offset then height scale of each tile type's color, see Tile::palette
+    std::array<std::array<float, 4>, 6> terrainPalette{};
 
     struct {
         bgfx::UniformHandle u_shadowMap;
+        bgfx::UniformHandle u_shadowTint;
+        bgfx::UniformHandle u_blueNoise;
         bgfx::UniformHandle u_lightDirMtx;
         bgfx::UniformHandle u_lightMapMtx;
         bgfx::UniformHandle u_modelMtx;
         bgfx::UniformHandle u_frame;
         bgfx::UniformHandle u_texture;
+        bgfx::UniformHandle u_heightmap;
+        bgfx::UniformHandle u_palette;
+        bgfx::UniformHandle u_upscale;
     } uniforms;
 
-    void drawTextureToScreen(bgfx::TextureHandle texture, float const z);
+    /**
+     * @brief Gets which view static shadow casters should be drawn in this frame
+     * 
+     * @return std::optional<bgfx::ViewId> nullopt if the cached static shadows are still good
+     */
+    std::optional<bgfx::ViewId> staticShadowView() const;
+
+    /**
+     * @brief The frame the simulation is currently filling in
+     * 
+     * @return FrameState& 
+     */
+    FrameState& frameState();
+    FrameState const & frameState() const;
+
+    /**
+     * @brief The frame that was submitted last, which is what's in screenTexture/screenDepth
+     * by the time anything drawn from here on runs. That only holds for views ordered
+     * after RENDER_SCENE_ID
+     * 
+     * @return FrameState const& 
+     */
+    FrameState const & lastFrameState() const;
+
+    /**
+     * @brief Where the draws for the frame being filled in go
+     * 
+     * @return RenderQueue& 
+     */
+    RenderQueue& renderQueue();
+
+    /**
+     * @brief Draws a texture over the whole screen
+     * 
+     * @param texture 
+     * @param z 
+     * @param scale how much of the texture (from the top left) to stretch over the screen
+     */
+    void drawTextureToScreen(bgfx::TextureHandle texture, float const z, float const scale = 1.f);
+
+    /**
+     * @brief Hands the frame that's been filled in off to be submitted on another thread,
+     * then switches to filling in the other one
+     * Call finishRender before anything else is drawn
+     */
+    void submitFrame();
+
+    /**
+     * @brief Waits for the last submitted frame to finish submitting, and passes it to
+     * bgfx's render thread
+     */
     void finishRender();
     
+    // these only store where they are in frameState, the views are set when it's submitted
     void setLightOrientation(bx::Vec3 from, bx::Vec3 to, float size, float depth);
     void setCameraOrientation(bx::Vec3 from, bx::Vec3 to);
 };
@@ -0,0 +1,67 @@
+#include "workerPool.h"
+
+WorkerPool::WorkerPool(std::size_t const threads) {
+    for(std::size_t i = 0; i < threads; i++) {
+        this->threads.emplace_back([this](){ this->workLoop(); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for(auto& thread: this->threads) thread.join();
+}
+
+void WorkerPool::run(std::size_t const jobs, std::function<void(std::size_t const)> job) {
+    this->start(jobs, std::move(job));
+    this->wait();
+}
+
+void WorkerPool::start(std::size_t const jobs, std::function<void(std::size_t const)> job) {
+    {
+        std::lock_guard lock(this->mutex);
+        this->job = std::move(job);
+        this->nextJob = 0;
+        this->jobCount = jobs;
+        this->unfinished = jobs;
+    }
+    this->wake.notify_all();
+}
+
+void WorkerPool::wait() {
+    std::unique_lock lock(this->mutex);
+    this->work(lock);
+    this->done.wait(lock, [this](){ return this->unfinished == 0; });
+
+    this->job = nullptr;
+    this->jobCount = 0;
+}
+
+std::size_t WorkerPool::size() const {
+    return this->threads.size() + 1;
+}
+
+void WorkerPool::workLoop() {
+    std::unique_lock lock(this->mutex);
+    while(true) {
+        this->wake.wait(lock, [this](){ return this->stopping || this->nextJob < this->jobCount; });
+        if(this->stopping) return;
+
+        this->work(lock);
+    }
+}
+
+void WorkerPool::work(std::unique_lock<std::mutex>& lock) {
+    while(this->nextJob < this->jobCount) {
+        auto const index = this->nextJob++;
+
+        lock.unlock();
+        this->job(index);
+        lock.lock();
+
+        if(--this->unfinished == 0) this->done.notify_all();
+    }
+}
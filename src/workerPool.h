@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A few threads that sit around waiting to be given jobs
+ * The thread handing out the jobs works on any that are left when it waits on them,
+ * so it isn't just sitting there
+ */
+struct WorkerPool {
+    /**
+     * @param threads how many to start, not counting the one calling run
+     */
+    WorkerPool(std::size_t const threads);
+    ~WorkerPool();
+
+    WorkerPool(WorkerPool const &) = delete;
+    WorkerPool& operator=(WorkerPool const &) = delete;
+
+    /**
+     * @brief Calls job once for each index from 0 to jobs - 1, spread over the threads, and
+     * waits for all of them to finish
+     * 
+     * @param jobs 
+     * @param job given which index it's for
+     */
+    void run(std::size_t const jobs, std::function<void(std::size_t const)> job);
+
+    /**
+     * @brief Hands out jobs like run, but doesn't wait for them
+     * Has to be waited on before anything else is started
+     * 
+     * @param jobs 
+     * @param job given which index it's for
+     */
+    void start(std::size_t const jobs, std::function<void(std::size_t const)> job);
+
+    /**
+     * @brief Waits for everything from the last start to finish, doing some of it if
+     * the threads haven't gotten to it yet
+     */
+    void wait();
+
+    /**
+     * @brief How many jobs can be worked on at once, including the calling thread
+     * 
+     * @return std::size_t 
+     */
+    std::size_t size() const;
+
+private:
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    std::function<void(std::size_t const)> job;
+    std::size_t nextJob = 0;
+    std::size_t jobCount = 0;
+    std::size_t unfinished = 0;
+    bool stopping = false;
+
+    void workLoop();
+    // takes jobs until there's none left, lock is held between them
+    void work(std::unique_lock<std::mutex>& lock);
+};